@@ -53,6 +53,112 @@ ConfigFile::parse()
         return false;
     }
 
+    auto latency = j["inputLatency"];
+    if (latency.is_number())
+    {
+        global_input_latency_us = latency.get<double>() * 1000;
+    }
+
+    auto late = j["lateBundles"];
+    if (late.is_string())
+    {
+        if (late == "bar") global_late_bundles = E_LATE_BUNDLE_BAR;
+        else if (late == "drop") global_late_bundles = E_LATE_BUNDLE_DROP;
+        else global_late_bundles = E_LATE_BUNDLE_NOW;
+    }
+
+    auto thinning = j["recordThinning"];
+    if (thinning.is_object())
+    {
+        auto spacing = thinning["spacing"];
+        if (spacing.is_number()) {
+            global_thin_spacing = spacing.get<long>();
+        }
+
+        auto repeats = thinning["dropRepeats"];
+        if (repeats.is_boolean()) {
+            global_thin_repeats = repeats.get<bool>();
+        }
+
+        auto tolerance = thinning["tolerance"];
+        if (tolerance.is_number()) {
+            global_thin_tolerance = tolerance.get<int>();
+        }
+    }
+
+    auto journal = j["journal"];
+    if (journal.is_boolean()) {
+        global_journal = journal.get<bool>();
+    }
+
+    auto controls = j["midiControls"];
+    if (controls.is_array())
+    {
+        for (json::iterator it = controls.begin(); it != controls.end(); ++it) {
+
+            auto control_data = it.value();
+
+            auto channel = control_data["channel"];
+            auto note = control_data["note"];
+            auto cc = control_data["control"];
+            auto action = control_data["action"];
+            auto col = control_data["col"];
+            auto row = control_data["row"];
+            auto value = control_data["value"];
+
+            if (!channel.is_number() || !action.is_string()) continue;
+
+            user_midi_control control;
+            control.channel = channel.get<int>() - 1;
+            control.action = action.get<string>();
+            control.value = -1;
+
+            // note 127 must not become control 0
+            if (note.is_number()) {
+                int number = note.get<int>();
+                if (number < 0 || number > 127) {
+                    cerr << "midiControls: note " << number << " out of range 0-127\n";
+                    continue;
+                }
+                control.entry = number;
+            } else if (cc.is_number()) {
+                int number = cc.get<int>();
+                if (number < 0 || number > 127) {
+                    cerr << "midiControls: control " << number << " out of range 0-127\n";
+                    continue;
+                }
+                control.entry = 128 + number;
+            } else {
+                continue;
+            }
+
+            if (control.action == "toggle" || control.action == "queue") {
+                if (col.is_number() && row.is_number()) {
+                    control.value = row.get<int>() + col.get<int>() * c_mainwnd_rows;
+                }
+            } else if (control.action == "scene") {
+                if (row.is_number()) {
+                    control.value = row.get<int>();
+                }
+            } else if (value.is_number()) {
+                control.value = value.get<int>();
+            }
+
+            global_user_midi_controls.push_back(control);
+        }
+    }
+
+    auto feedback = j["controlFeedbackBus"];
+    if (feedback.is_number())
+    {
+        int bus = feedback.get<int>();
+        if (bus >= 0 && bus < c_maxBuses) {
+            global_control_feedback_bus = bus;
+        } else {
+            cerr << "controlFeedbackBus: no such bus " << bus << "\n";
+        }
+    }
+
     auto buses = j["buses"];
     if (buses.is_object())
     {
@@ -24,8 +24,6 @@ event::event()
     m_data[0] = 0;
     m_data[1] = 0;
 
-    m_sysex = NULL;
-
     m_linked = NULL;
     m_selected = false;
     m_marked = false;
@@ -33,14 +31,6 @@ event::event()
     m_painted = false;
 }
 
-event::~event()
-{
-  if ( m_sysex != NULL )
-    delete[] m_sysex;
-
-  m_sysex = NULL;
-}
-
 long
 event::get_timestamp()
 {
@@ -142,11 +132,7 @@ event::get_status( )
 void
 event::start_sysex()
 {
-  if ( m_sysex != NULL )
-    delete[] m_sysex;
-
-  m_sysex = NULL;
-  m_size = 0;
+  m_sysex.reset();
 }
 
 bool
@@ -154,17 +140,16 @@ event::append_sysex( unsigned char *a_data, long a_size )
 {
   bool ret = true;
 
-  unsigned char *buffer = new unsigned char[m_size + a_size];
-
-  /* copy old and append */
-  memcpy(  buffer        , m_sysex, m_size );
-  memcpy( &buffer[m_size], a_data, a_size );
+  /* don't write through a buffer shared with a copy */
+  if ( !m_sysex || m_sysex.use_count() > 1 ){
 
-  if ( m_sysex != NULL )
-    delete[] m_sysex;
+      if ( m_sysex )
+          m_sysex = make_shared < vector < unsigned char > > ( *m_sysex );
+      else
+          m_sysex = make_shared < vector < unsigned char > > ();
+  }
 
-  m_size = m_size + a_size;
-  m_sysex = buffer;
+  m_sysex->insert( m_sysex->end(), a_data, a_data + a_size );
 
   for ( int i=0; i<a_size; i++ ){
 
@@ -176,25 +161,30 @@ event::append_sysex( unsigned char *a_data, long a_size )
 
 }
 
-
-unsigned char *
-event::get_sysex()
+void
+event::set_sysex( unsigned char *a_data, long a_size )
 {
-  return m_sysex;
+  m_sysex = make_shared < vector < unsigned char > > ( a_data, a_data + a_size );
 }
 
 
-
-void
-event::set_size( long a_size )
+unsigned char *
+event::get_sysex()
 {
-  m_size = a_size;
+  if ( !m_sysex || m_sysex->empty() )
+    return NULL;
+
+  return &(*m_sysex)[0];
 }
 
+
 long
 event::get_size()
 {
-  return m_size;
+  if ( !m_sysex )
+    return 0;
+
+  return m_sysex->size();
 }
 
 void
@@ -239,17 +229,17 @@ event::print()
 {
     printf( "[%06ld] [%04lX] %02X ",
 	    m_timestamp,
-	    m_size,
+	    get_size(),
 	    m_status );
 
     if ( m_status == EVENT_SYSEX ){
 
-      for( int i=0; i<m_size; i++ ){
+      for( int i=0; i<get_size(); i++ ){
 
 	if ( i%16 == 0 )
 	  printf( "\n    " );
 
-	printf( "%02X ", m_sysex[i] );
+	printf( "%02X ", (*m_sysex)[i] );
 
       }
 
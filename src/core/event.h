@@ -19,6 +19,9 @@
 
 #include <stdio.h>
 
+#include <memory>
+#include <vector>
+
 #include "globals.h"
 
 const unsigned char  EVENT_STATUS_BIT       = 0x80;
@@ -60,8 +63,9 @@ class event
     /* data for event */
     unsigned char m_data[2];
 
-    /* data for sysex */
-    unsigned char *m_sysex;
+    /* data for sysex, from F0 to F7. Copies of an event share
+       the buffer, it is only copied when one of them appends */
+    shared_ptr < vector < unsigned char > > m_sysex;
 
     /* used to link note ons and offs together */
     event *m_linked;
@@ -76,16 +80,12 @@ class event
     /* is this event being painted */
     bool m_painted;
 
-    /* size of sysex message */
-    long m_size;
-
     /* used in sorting */
     int get_rank( ) const;
 
  public:
 
     event();
-    ~event();
 
     void set_timestamp( const unsigned long time );
     long get_timestamp();
@@ -104,11 +104,12 @@ class event
 
     void start_sysex();
     bool append_sysex( unsigned char *a_data, long size );
+    void set_sysex( unsigned char *a_data, long size );
     unsigned char *get_sysex();
 
     void set_note( char a_note );
 
-    void set_size( long a_size );
+    /* size of the sysex message */
     long get_size();
 
     void link( event *event );
@@ -0,0 +1,255 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "eventindex.h"
+#include <algorithm>
+
+eventindex::eventindex()
+{
+    m_valid = false;
+}
+
+void
+eventindex::invalidate()
+{
+    m_valid = false;
+}
+
+bool
+eventindex::is_valid()
+{
+    return m_valid;
+}
+
+/* floor division, ticks before 0 land in negative buckets */
+long
+eventindex::bucket( long a_tick )
+{
+    if ( a_tick < 0 )
+        return - ((- a_tick - 1) / c_eventindex_bucket) - 1;
+
+    return a_tick / c_eventindex_bucket;
+}
+
+/* lane key: status, plus controller number for control changes */
+int
+eventindex::lane( unsigned char a_status, unsigned char a_cc )
+{
+    if ( a_status == EVENT_CONTROL_CHANGE )
+        return (a_status << 8) | a_cc;
+
+    return a_status << 8;
+}
+
+/* position of the first event at or after a_tick */
+size_t
+eventindex::first_at( vector < iterator > *a_events, long a_tick )
+{
+    size_t lo = 0, hi = a_events->size();
+    while ( lo < hi ){
+        size_t mid = (lo + hi) / 2;
+        if ( (*(*a_events)[mid]).get_timestamp() < a_tick )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+void
+eventindex::add_span( iterator a_e, int a_note, long a_tick_s, long a_tick_f,
+                      bool a_wrapped )
+{
+    note_span span;
+
+    span.m_event = a_e;
+    span.m_tick_s = a_tick_s;
+    span.m_tick_f = a_tick_f;
+    span.m_wrapped = a_wrapped;
+
+    int n = m_spans.size();
+    m_spans.push_back( span );
+
+    if ( a_wrapped ){
+        m_note_wrapped[a_note].push_back( n );
+        return;
+    }
+
+    for ( long b = bucket( a_tick_s ); b <= bucket( a_tick_f ); b++ )
+        m_note_buckets[a_note][b].push_back( n );
+}
+
+static bool
+timestamp_less( eventindex::iterator a, eventindex::iterator b )
+{
+    return (*a).get_timestamp() < (*b).get_timestamp();
+}
+
+void
+eventindex::build( list<event> *a_list )
+{
+    m_spans.clear();
+    m_ticks.clear();
+    m_lanes.clear();
+
+    for ( int i = 0; i < c_num_keys; i++ ){
+        m_note_buckets[i].clear();
+        m_note_wrapped[i].clear();
+    }
+
+    m_ticks.reserve( a_list->size() );
+
+    for ( iterator i = a_list->begin(); i != a_list->end(); i++ ){
+
+        m_ticks.push_back( i );
+
+        unsigned char d0, d1;
+        (*i).get_data( &d0, &d1 );
+        m_lanes[ lane( (*i).get_status(), d0 ) ].push_back( i );
+
+        /* poly aftertouch goes along with the notes it belongs to */
+        if ( !(*i).is_note_on() && !(*i).is_note_off() &&
+             (*i).get_status() != EVENT_AFTERTOUCH )
+            continue;
+
+        int note = (*i).get_note();
+        long tick_s = (*i).get_timestamp();
+        long tick_f = tick_s;
+
+        if ( (*i).is_linked() ){
+
+            if ( (*i).is_note_on() )
+                tick_f = (*i).get_linked()->get_timestamp();
+            else
+                tick_s = (*i).get_linked()->get_timestamp();
+
+            add_span( i, note, tick_s, tick_f, tick_s > tick_f );
+        }
+        else {
+            add_span( i, note, tick_s, tick_s + c_eventindex_note_width, false );
+        }
+    }
+
+    /* the list is kept sorted, but don't trust it blindly */
+    if ( !is_sorted( m_ticks.begin(), m_ticks.end(), timestamp_less )){
+
+        stable_sort( m_ticks.begin(), m_ticks.end(), timestamp_less );
+
+        map < int, vector < iterator > >::iterator l;
+        for ( l = m_lanes.begin(); l != m_lanes.end(); l++ )
+            stable_sort( l->second.begin(), l->second.end(), timestamp_less );
+    }
+
+    m_valid = true;
+}
+
+void
+eventindex::find_notes( long a_tick_s, long a_tick_f,
+                        int a_note_l, int a_note_h,
+                        vector < iterator > *a_result )
+{
+    vector < int > found;
+
+    if ( a_note_l < 0 ) a_note_l = 0;
+    if ( a_note_h >= c_num_keys ) a_note_h = c_num_keys - 1;
+
+    long first = bucket( a_tick_s );
+    long last = bucket( a_tick_f );
+
+    for ( int note = a_note_l; note <= a_note_h; note++ ){
+
+        map < long, vector < int > >::iterator b;
+
+        for ( b = m_note_buckets[note].lower_bound( first );
+              b != m_note_buckets[note].end() && b->first <= last; b++ ){
+
+            for ( size_t j = 0; j < b->second.size(); j++ ){
+
+                note_span &span = m_spans[ b->second[j] ];
+
+                if ( span.m_tick_s <= a_tick_f && span.m_tick_f >= a_tick_s &&
+                     /* a long note sits in several buckets, report it once */
+                     max( bucket( span.m_tick_s ), first ) == b->first )
+                {
+                    found.push_back( b->second[j] );
+                }
+            }
+        }
+
+        for ( size_t j = 0; j < m_note_wrapped[note].size(); j++ ){
+
+            note_span &span = m_spans[ m_note_wrapped[note][j] ];
+
+            if ( span.m_tick_s <= a_tick_f || span.m_tick_f >= a_tick_s )
+                found.push_back( m_note_wrapped[note][j] );
+        }
+    }
+
+    /* spans are numbered in list order */
+    sort( found.begin(), found.end() );
+
+    for ( size_t j = 0; j < found.size(); j++ )
+        a_result->push_back( m_spans[ found[j] ].m_event );
+}
+
+void
+eventindex::find_events( long a_tick_s, long a_tick_f,
+                         vector < iterator > *a_result )
+{
+    vector < iterator >::iterator i;
+
+    for ( i = m_ticks.begin() + first_at( &m_ticks, a_tick_s );
+          i != m_ticks.end() && (**i).get_timestamp() <= a_tick_f; i++ )
+        a_result->push_back( *i );
+}
+
+void
+eventindex::find_lane_events( unsigned char a_status, unsigned char a_cc,
+                              long a_tick_s, long a_tick_f,
+                              vector < iterator > *a_result )
+{
+    map < int, vector < iterator > >::iterator l = m_lanes.find( lane( a_status, a_cc ));
+
+    if ( l == m_lanes.end() )
+        return;
+
+    vector < iterator >::iterator i;
+
+    for ( i = l->second.begin() + first_at( &l->second, a_tick_s );
+          i != l->second.end() && (**i).get_timestamp() <= a_tick_f; i++ )
+        a_result->push_back( *i );
+}
+
+void
+eventindex::get_lane_events( unsigned char a_status, unsigned char a_cc,
+                             vector < iterator > *a_result )
+{
+    map < int, vector < iterator > >::iterator l = m_lanes.find( lane( a_status, a_cc ));
+
+    if ( l != m_lanes.end() )
+        a_result->insert( a_result->end(), l->second.begin(), l->second.end() );
+}
+
+void
+eventindex::get_lanes( vector < pair < unsigned char, unsigned char > > *a_lanes )
+{
+    map < int, vector < iterator > >::iterator l;
+
+    for ( l = m_lanes.begin(); l != m_lanes.end(); l++ )
+        a_lanes->push_back( make_pair( (unsigned char) (l->first >> 8),
+                                       (unsigned char) (l->first & 0xFF) ));
+}
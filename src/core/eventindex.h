@@ -0,0 +1,117 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SEQ192_EVENTINDEX
+#define SEQ192_EVENTINDEX
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "event.h"
+#include "globals.h"
+
+/* ticks covered by one bucket of the note index (one 4/4 bar) */
+const long c_eventindex_bucket = c_ppqn * 4;
+
+/* unlinked note events, and polyphonic aftertouch, are hit within
+   this many ticks */
+const long c_eventindex_note_width = 16;
+
+/* lookup tables over a sorted event list, used by the hit-testing
+   and selection queries of the sequence. The index holds iterators
+   into the list it was built from: the owner must invalidate it
+   whenever events are added, removed, moved or relinked. */
+class eventindex
+{
+
+ public:
+
+    typedef list<event>::iterator iterator;
+
+ private:
+
+    /* span covered by a note event, on and off share the same span */
+    struct note_span
+    {
+        iterator m_event;
+        long m_tick_s;
+        long m_tick_f;
+        bool m_wrapped;
+    };
+
+    vector < note_span > m_spans;
+
+    /* per note: bucket number -> spans overlapping that bucket */
+    map < long, vector < int > > m_note_buckets[c_num_keys];
+
+    /* per note: spans wrapping around the end of the sequence */
+    vector < int > m_note_wrapped[c_num_keys];
+
+    /* every event, sorted by timestamp */
+    vector < iterator > m_ticks;
+
+    /* per status (and controller for CC): the events of that lane,
+       sorted by timestamp */
+    map < int, vector < iterator > > m_lanes;
+
+    bool m_valid;
+
+    static long bucket( long a_tick );
+    static int lane( unsigned char a_status, unsigned char a_cc );
+    static size_t first_at( vector < iterator > *a_events, long a_tick );
+
+    void add_span( iterator a_e, int a_note, long a_tick_s, long a_tick_f,
+                   bool a_wrapped );
+
+ public:
+
+    eventindex();
+
+    void invalidate();
+    bool is_valid();
+
+    /* rebuilds the tables from a_list */
+    void build( list<event> *a_list );
+
+    /* fills a_result with the note events (and polyphonic aftertouch)
+       of notes a_note_l to a_note_h whose span overlaps
+       a_tick_s .. a_tick_f, in list order */
+    void find_notes( long a_tick_s, long a_tick_f,
+                     int a_note_l, int a_note_h,
+                     vector < iterator > *a_result );
+
+    /* fills a_result with the events stamped a_tick_s .. a_tick_f,
+       in list order */
+    void find_events( long a_tick_s, long a_tick_f,
+                      vector < iterator > *a_result );
+
+    /* same as find_events, restricted to the events of a_status
+       (and controller a_cc if a_status is a control change) */
+    void find_lane_events( unsigned char a_status, unsigned char a_cc,
+                           long a_tick_s, long a_tick_f,
+                           vector < iterator > *a_result );
+
+    /* all the events of a lane, in list order */
+    void get_lane_events( unsigned char a_status, unsigned char a_cc,
+                          vector < iterator > *a_result );
+
+    /* fills a_lanes with the status / controller of every lane
+       holding at least one event */
+    void get_lanes( vector < pair < unsigned char, unsigned char > > *a_lanes );
+};
+
+#endif
@@ -0,0 +1,174 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#include "eventstats.h"
+
+eventstats::eventstats()
+{
+    build( NULL, c_ppqn * 4 );
+}
+
+void
+eventstats::build( list<event> *a_list, long a_bar_length )
+{
+    for ( int i = 0; i < c_num_keys; i++ ){
+        m_notes[i] = 0;
+        m_controls[i] = 0;
+    }
+
+    for ( int i = 0; i < 16; i++ )
+        m_status[i] = 0;
+
+    m_note_low = c_num_keys - 1;
+    m_note_high = 0;
+    m_events = 0;
+    m_last_tick = 0;
+
+    m_bar_notes.clear();
+    m_bar_length = a_bar_length > 0 ? a_bar_length : c_ppqn * 4;
+
+    if ( a_list == NULL )
+        return;
+
+    list<event>::iterator i;
+    for ( i = a_list->begin(); i != a_list->end(); i++ )
+        add( &(*i) );
+}
+
+void
+eventstats::count( event *a_e, int a_delta )
+{
+    m_events += a_delta;
+    m_status[ a_e->get_status() >> 4 ] += a_delta;
+
+    if ( a_e->get_status() == EVENT_CONTROL_CHANGE ){
+
+        unsigned char d0, d1;
+        a_e->get_data( &d0, &d1 );
+        m_controls[ d0 & 0x7F ] += a_delta;
+    }
+
+    if ( a_e->is_note_on() || a_e->is_note_off() ){
+
+        int note = a_e->get_note();
+        m_notes[note] += a_delta;
+
+        if ( a_delta > 0 ){
+            if ( note < m_note_low ) m_note_low = note;
+            if ( note > m_note_high ) m_note_high = note;
+        }
+        else if ( m_notes[note] == 0 &&
+                  (note == m_note_low || note == m_note_high) ){
+            update_note_range();
+        }
+    }
+
+    /* events before 0 are about to be pruned by the sequence */
+    if ( a_e->is_note_on() && a_e->get_timestamp() >= 0 ){
+
+        size_t bar = a_e->get_timestamp() / m_bar_length;
+
+        if ( bar >= m_bar_notes.size() )
+            m_bar_notes.resize( bar + 1, 0 );
+
+        m_bar_notes[bar] += a_delta;
+    }
+}
+
+/* rescan the keys once the lowest or highest one is gone */
+void
+eventstats::update_note_range()
+{
+    int low = c_num_keys - 1;
+    int high = 0;
+
+    for ( int i = 0; i < c_num_keys; i++ ){
+        if ( m_notes[i] > 0 ){
+            if ( i < low ) low = i;
+            high = i;
+        }
+    }
+
+    m_note_low = low;
+    m_note_high = high;
+}
+
+void
+eventstats::add( event *a_e )
+{
+    count( a_e, 1 );
+
+    if ( a_e->get_timestamp() > m_last_tick )
+        m_last_tick = a_e->get_timestamp();
+}
+
+void
+eventstats::remove( event *a_e )
+{
+    count( a_e, -1 );
+}
+
+void
+eventstats::set_last_tick( long a_tick )
+{
+    m_last_tick = a_tick;
+}
+
+int
+eventstats::get_lowest_note()
+{
+    return m_note_low;
+}
+
+int
+eventstats::get_highest_note()
+{
+    return m_note_high;
+}
+
+int
+eventstats::get_event_count()
+{
+    return m_events;
+}
+
+int
+eventstats::get_status_count( unsigned char a_status )
+{
+    return m_status[ a_status >> 4 ];
+}
+
+int
+eventstats::get_control_count( unsigned char a_cc )
+{
+    return m_controls[ a_cc & 0x7F ];
+}
+
+long
+eventstats::get_last_tick()
+{
+    return m_last_tick;
+}
+
+void
+eventstats::get_bar_notes( vector < int > *a_bars, size_t a_count )
+{
+    a_bars->assign( a_count, 0 );
+
+    for ( size_t i = 0; i < a_count && i < m_bar_notes.size(); i++ )
+        (*a_bars)[i] = m_bar_notes[i];
+}
@@ -0,0 +1,85 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef SEQ192_EVENTSTATS
+#define SEQ192_EVENTSTATS
+
+#include <atomic>
+#include <list>
+#include <vector>
+
+#include "event.h"
+#include "globals.h"
+
+/* summary of the events of a sequence, kept up to date by the sequence
+   as events are added and removed. The counters are atomic so that the
+   interface can read them without taking the sequence lock; the note
+   density per bar is only accessed under the sequence lock. */
+class eventstats
+{
+
+ private:
+
+    /* note on and note off events per key */
+    atomic < int > m_notes[c_num_keys];
+    atomic < int > m_note_low;
+    atomic < int > m_note_high;
+
+    /* events per status (upper nibble) */
+    atomic < int > m_status[16];
+
+    /* control changes per controller number */
+    atomic < int > m_controls[c_num_keys];
+
+    atomic < int > m_events;
+    atomic < long > m_last_tick;
+
+    /* note ons starting in each bar */
+    vector < int > m_bar_notes;
+    long m_bar_length;
+
+    void count( event *a_e, int a_delta );
+    void update_note_range();
+
+ public:
+
+    eventstats();
+
+    /* resets the statistics, then counts every event of a_list */
+    void build( list<event> *a_list, long a_bar_length );
+
+    void add( event *a_e );
+    void remove( event *a_e );
+
+    /* the owner knows the last event of its sorted list */
+    void set_last_tick( long a_tick );
+
+    /* 127 and 0 when there are no notes */
+    int get_lowest_note();
+    int get_highest_note();
+
+    int get_event_count();
+    int get_status_count( unsigned char a_status );
+    int get_control_count( unsigned char a_cc );
+    long get_last_tick();
+
+    /* fills a_bars with the number of note ons in each of the
+       first a_count bars */
+    void get_bar_notes( vector < int > *a_bars, size_t a_count );
+};
+
+#endif
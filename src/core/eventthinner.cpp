@@ -0,0 +1,160 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "eventthinner.h"
+
+#include <math.h>
+
+bool
+eventthinner::applies( event *a_e )
+{
+    unsigned char status = a_e->get_status();
+
+    return status == EVENT_CONTROL_CHANGE ||
+           status == EVENT_AFTERTOUCH ||
+           status == EVENT_CHANNEL_PRESSURE ||
+           status == EVENT_PITCH_WHEEL;
+}
+
+/* controller or key for the statuses that have one */
+int
+eventthinner::key( event *a_e )
+{
+    unsigned char d0, d1;
+    a_e->get_data( &d0, &d1 );
+
+    unsigned char status = a_e->get_status();
+
+    if ( status == EVENT_CONTROL_CHANGE || status == EVENT_AFTERTOUCH )
+        return status << 8 | d0;
+
+    return status << 8;
+}
+
+int
+eventthinner::value( event *a_e )
+{
+    unsigned char d0, d1;
+    a_e->get_data( &d0, &d1 );
+
+    switch ( a_e->get_status() ){
+
+        case EVENT_PITCH_WHEEL:
+            return d1 << 7 | d0;
+
+        case EVENT_CHANNEL_PRESSURE:
+            return d0;
+
+        default:
+            return d1;
+    }
+}
+
+void
+eventthinner::commit( lane *a_lane, event *a_e, vector < event > *a_out )
+{
+    a_lane->m_has_last = true;
+    a_lane->m_last_tick = a_e->get_timestamp();
+    a_lane->m_last_value = value( a_e );
+
+    a_lane->m_slope_low = - HUGE_VAL;
+    a_lane->m_slope_high = HUGE_VAL;
+
+    a_out->push_back( *a_e );
+}
+
+void
+eventthinner::push( event *a_e, vector < event > *a_out )
+{
+    lane &l = m_lanes[ key( a_e ) ];
+
+    long tick = a_e->get_timestamp();
+    int v = value( a_e );
+
+    /* wrapped around the sequence, start over */
+    if ( l.m_has_last && tick < l.m_last_tick ){
+
+        if ( l.m_has_pending )
+            commit( &l, &l.m_pending, a_out );
+
+        l.m_has_pending = false;
+        l.m_has_last = false;
+    }
+
+    if ( !l.m_has_last ){
+        l.m_has_pending = false;
+        commit( &l, a_e, a_out );
+        return;
+    }
+
+    /* nothing new */
+    int previous = l.m_has_pending ? value( &l.m_pending ) : l.m_last_value;
+    if ( global_thin_repeats && v == previous )
+        return;
+
+    if ( l.m_has_pending ){
+
+        long pending_tick = l.m_pending.get_timestamp();
+        bool needed = pending_tick - l.m_last_tick >= global_thin_spacing;
+
+        /* the line from the last point to this one passes
+           close enough to every point since */
+        if ( needed && global_thin_tolerance >= 0 && tick > l.m_last_tick ){
+
+            double slope = (double) (v - l.m_last_value) / (tick - l.m_last_tick);
+
+            if ( slope >= l.m_slope_low && slope <= l.m_slope_high )
+                needed = false;
+        }
+
+        if ( needed )
+            commit( &l, &l.m_pending, a_out );
+
+        l.m_has_pending = false;
+    }
+
+    if ( global_thin_tolerance < 0 && tick - l.m_last_tick >= global_thin_spacing ){
+        commit( &l, a_e, a_out );
+        return;
+    }
+
+    l.m_pending = *a_e;
+    l.m_has_pending = true;
+
+    if ( tick > l.m_last_tick ){
+
+        double dt = tick - l.m_last_tick;
+
+        l.m_slope_low = max( l.m_slope_low,
+                (v - global_thin_tolerance - l.m_last_value) / dt );
+        l.m_slope_high = min( l.m_slope_high,
+                (v + global_thin_tolerance - l.m_last_value) / dt );
+    }
+}
+
+void
+eventthinner::flush( vector < event > *a_out )
+{
+    map < int, lane >::iterator i;
+
+    for ( i = m_lanes.begin(); i != m_lanes.end(); i++ ){
+
+        if ( i->second.m_has_pending )
+            a_out->push_back( i->second.m_pending );
+    }
+
+    m_lanes.clear();
+}
@@ -0,0 +1,76 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SEQ192_EVENTTHINNER
+#define SEQ192_EVENTTHINNER
+
+#include <map>
+#include <vector>
+
+#include "event.h"
+#include "globals.h"
+
+/* reduces a recorded controller stream (control change, aftertouch,
+   channel pressure, pitch wheel) before it reaches the sequence: keeps
+   at most one point per global_thin_spacing ticks, drops repeated
+   values and, if global_thin_tolerance is not negative, points lying
+   within that tolerance of a line between the points kept around them
+   (swinging door). The last point of a lane is held back until the
+   next one shows whether it is needed. */
+class eventthinner
+{
+
+ private:
+
+    struct lane
+    {
+        /* last point let through */
+        bool m_has_last;
+        long m_last_tick;
+        int m_last_value;
+
+        /* newest point, waiting for the next one */
+        bool m_has_pending;
+        event m_pending;
+
+        /* slopes from the last point keeping every point since
+           within the tolerance */
+        double m_slope_low;
+        double m_slope_high;
+
+        lane() : m_has_last( false ), m_has_pending( false ) {}
+    };
+
+    map < int, lane > m_lanes;
+
+    static int key( event *a_e );
+    static int value( event *a_e );
+
+    void commit( lane *a_lane, event *a_e, vector < event > *a_out );
+
+ public:
+
+    /* true for the events push() applies to */
+    static bool applies( event *a_e );
+
+    /* feeds a recorded event, fills a_out with the events to insert */
+    void push( event *a_e, vector < event > *a_out );
+
+    /* lets the held back points through */
+    void flush( vector < event > *a_out );
+};
+
+#endif
@@ -0,0 +1,523 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#include "eventtransform.h"
+
+#include <map>
+#include <sstream>
+#include <stdlib.h>
+
+/* only loaded because linked to a transformed note */
+static const unsigned char c_transform_partner = 0x01;
+
+/* timestamp, status or note changed, the event has to be reinserted */
+static const unsigned char c_transform_moved = 0x02;
+
+/* only the values changed, the event can be updated in place */
+static const unsigned char c_transform_changed = 0x04;
+
+eventtransform::eventtransform()
+{
+}
+
+void
+eventtransform::clear()
+{
+    m_steps.clear();
+}
+
+bool
+eventtransform::empty()
+{
+    return m_steps.empty();
+}
+
+void
+eventtransform::add_step( transform_type a_type, long a_value )
+{
+    step s;
+
+    s.m_type = a_type;
+    s.m_status = 0;
+    s.m_cc = 0;
+    s.m_value = a_value;
+    s.m_divide = 1;
+    s.m_linked = false;
+    s.m_multiplier = 1.0;
+
+    m_steps.push_back( s );
+}
+
+void
+eventtransform::add_transpose( int a_steps )
+{
+    add_step( TRANSFORM_TRANSPOSE, a_steps );
+}
+
+void
+eventtransform::add_shift( long a_ticks )
+{
+    add_step( TRANSFORM_SHIFT, a_ticks );
+}
+
+void
+eventtransform::add_quantize( unsigned char a_status, unsigned char a_cc,
+                              long a_snap_tick, int a_divide, bool a_linked )
+{
+    /* nothing to snap to */
+    if ( a_snap_tick <= 0 || a_divide <= 0 )
+        return;
+
+    add_step( TRANSFORM_QUANTIZE, a_snap_tick );
+    m_steps.back().m_status = a_status;
+    m_steps.back().m_cc = a_cc;
+    m_steps.back().m_divide = a_divide;
+    m_steps.back().m_linked = a_linked;
+}
+
+void
+eventtransform::add_randomize( unsigned char a_status, int a_amount )
+{
+    add_step( TRANSFORM_RANDOMIZE, a_amount );
+    m_steps.back().m_status = a_status;
+}
+
+void
+eventtransform::add_scale( float a_multiplier )
+{
+    add_step( TRANSFORM_SCALE, 0 );
+    m_steps.back().m_multiplier = a_multiplier;
+}
+
+void
+eventtransform::add_reverse()
+{
+    add_step( TRANSFORM_REVERSE, 0 );
+}
+
+float
+eventtransform::get_length_ratio()
+{
+    float ratio = 1.0;
+
+    for ( size_t i = 0; i < m_steps.size(); i++ )
+        if ( m_steps[i].m_type == TRANSFORM_SCALE )
+            ratio *= m_steps[i].m_multiplier;
+
+    return ratio;
+}
+
+bool
+eventtransform::parse( const char *a_chain )
+{
+    stringstream chain( a_chain );
+    string item;
+
+    while ( getline( chain, item, ';' )){
+
+        stringstream args( item );
+        string name;
+        double value = 0, divide = 1;
+
+        if ( !(args >> name) )
+            continue;
+
+        if ( name == "reverse" ){
+            add_reverse();
+            continue;
+        }
+
+        if ( !(args >> value) )
+            return false;
+
+        if ( name == "transpose" )
+            add_transpose( (int) value );
+        else if ( name == "shift" )
+            add_shift( (long) value );
+        else if ( name == "quantize" ){
+            args >> divide;
+            add_quantize( EVENT_NOTE_ON, 0, (long) value, (int) divide, true );
+        }
+        else if ( name == "randomize" ){
+            if ( value < 1 || value > 127 )
+                return false;
+            add_randomize( EVENT_NOTE_ON, (int) value );
+        }
+        else if ( name == "multiply" ){
+            if ( value <= 0 )
+                return false;
+            add_scale( (float) value );
+        }
+        else
+            return false;
+    }
+
+    return true;
+}
+
+void
+eventtransform::push( iterator a_e, unsigned char a_flags )
+{
+    unsigned char d0, d1;
+    (*a_e).get_data( &d0, &d1 );
+
+    m_events.push_back( a_e );
+    m_ticks.push_back( (*a_e).get_timestamp() );
+    m_status.push_back( (*a_e).get_status() );
+    m_d0.push_back( d0 );
+    m_d1.push_back( d1 );
+    m_link.push_back( -1 );
+    m_flags.push_back( a_flags );
+}
+
+void
+eventtransform::load( list<event> *a_list, bool a_selected )
+{
+    m_events.clear();
+    m_ticks.clear();
+    m_status.clear();
+    m_d0.clear();
+    m_d1.clear();
+    m_link.clear();
+    m_flags.clear();
+
+    map < event *, int > loaded;
+    map < event *, iterator > others;
+
+    for ( iterator i = a_list->begin(); i != a_list->end(); i++ ){
+
+        (*i).unmark();
+
+        if ( !a_selected || (*i).is_selected() ){
+
+            if ( (*i).is_linked() )
+                loaded[ &(*i) ] = m_events.size();
+
+            push( i, 0 );
+        }
+        else if ( (*i).is_linked() ){
+            others[ &(*i) ] = i;
+        }
+    }
+
+    /* pair the linked notes, loading the missing halves */
+    size_t count = m_events.size();
+
+    for ( size_t k = 0; k < count; k++ ){
+
+        if ( !(*m_events[k]).is_linked() )
+            continue;
+
+        event *linked = (*m_events[k]).get_linked();
+
+        if ( loaded.count( linked ) ){
+            m_link[k] = loaded[linked];
+        }
+        else if ( others.count( linked ) ){
+            m_link[k] = m_events.size();
+            push( others[linked], c_transform_partner );
+            m_link.back() = k;
+        }
+    }
+}
+
+void
+eventtransform::transpose( step *a_step )
+{
+    size_t count = m_events.size();
+
+    for ( size_t k = 0; k < count; k++ ){
+
+        if ( m_flags[k] & c_transform_partner )
+            continue;
+
+        if ( m_status[k] == EVENT_NOTE_ON ||
+             m_status[k] == EVENT_NOTE_OFF ||
+             m_status[k] == EVENT_AFTERTOUCH ){
+
+            m_d0[k] = (m_d0[k] + a_step->m_value) & 0x7F;
+            m_flags[k] |= c_transform_moved;
+        }
+    }
+}
+
+void
+eventtransform::shift( step *a_step, long a_length )
+{
+    size_t count = m_events.size();
+
+    for ( size_t k = 0; k < count; k++ ){
+
+        if ( m_flags[k] & c_transform_partner )
+            continue;
+
+        long timestamp = m_ticks[k] + a_step->m_value;
+
+        /* wraparound */
+        if ( timestamp < 0L )
+            timestamp = a_length - ( (-timestamp) % a_length );
+        else
+            timestamp %= a_length;
+
+        m_ticks[k] = timestamp;
+        m_flags[k] |= c_transform_moved;
+    }
+}
+
+void
+eventtransform::quantize( step *a_step, long a_length )
+{
+    long snap = a_step->m_value;
+    size_t count = m_events.size();
+
+    for ( size_t k = 0; k < count; k++ ){
+
+        if ( m_flags[k] & c_transform_partner )
+            continue;
+
+        if ( m_status[k] != a_step->m_status )
+            continue;
+
+        if ( a_step->m_status == EVENT_CONTROL_CHANGE && m_d0[k] != a_step->m_cc )
+            continue;
+
+        long timestamp = m_ticks[k];
+        long timestamp_remander = timestamp % snap;
+        long timestamp_delta;
+
+        if ( timestamp_remander < snap / 2 )
+            timestamp_delta = - (timestamp_remander / a_step->m_divide );
+        else
+            timestamp_delta = (snap - timestamp_remander) / a_step->m_divide;
+
+        /* wrap around note ON to the front */
+        if ( timestamp_delta + timestamp >= a_length )
+            timestamp_delta = - timestamp;
+
+        m_ticks[k] = timestamp + timestamp_delta;
+        m_flags[k] |= c_transform_moved;
+
+        int p = m_link[k];
+
+        if ( p < 0 || !a_step->m_linked )
+            continue;
+
+        long adjusted_timestamp = m_ticks[p] + timestamp_delta;
+
+        /* note OFF wrapped before the adjustment */
+        if ( adjusted_timestamp < 0 )
+            adjusted_timestamp += a_length;
+
+        /* verify_and_link() discards notes at or past the end:
+           trim at the end, wrap past it */
+        if ( adjusted_timestamp == a_length )
+            adjusted_timestamp -= c_note_off_margin;
+
+        if ( adjusted_timestamp > a_length )
+            adjusted_timestamp -= a_length;
+
+        m_ticks[p] = adjusted_timestamp;
+        m_flags[p] |= c_transform_moved;
+    }
+}
+
+void
+eventtransform::randomize( step *a_step )
+{
+    unsigned char *data = m_d0.data();
+    size_t count = m_events.size();
+
+    /* the value is in the second byte for these */
+    if ( a_step->m_status == EVENT_NOTE_ON ||
+         a_step->m_status == EVENT_NOTE_OFF ||
+         a_step->m_status == EVENT_AFTERTOUCH ||
+         a_step->m_status == EVENT_CONTROL_CHANGE ||
+         a_step->m_status == EVENT_PITCH_WHEEL )
+        data = m_d1.data();
+
+    int plus_minus = a_step->m_value;
+
+    /* keeps the divisor below in range */
+    if ( plus_minus <= 0 )
+        return;
+    if ( plus_minus > 127 )
+        plus_minus = 127;
+
+    for ( size_t k = 0; k < count; k++ ){
+
+        if ( m_flags[k] & c_transform_partner )
+            continue;
+
+        if ( m_status[k] != a_step->m_status )
+            continue;
+
+        // See http://c-faq.com/lib/randrange.html
+        int random = (rand() / (RAND_MAX / ((2 * plus_minus) + 1) + 1)) - plus_minus;
+        int value = data[k] + random;
+
+        if ( value > 127 )
+            value = 127;
+        else if ( value < 0 )
+            value = 0;
+
+        data[k] = value;
+        m_flags[k] |= c_transform_changed;
+    }
+}
+
+void
+eventtransform::scale( step *a_step, long a_length )
+{
+    size_t count = m_events.size();
+
+    for ( size_t k = 0; k < count; k++ ){
+
+        if ( m_flags[k] & c_transform_partner )
+            continue;
+
+        long timestamp = m_ticks[k];
+
+        if ( m_status[k] == EVENT_NOTE_OFF )
+            timestamp += c_note_off_margin;
+
+        timestamp *= a_step->m_multiplier;
+
+        if ( m_status[k] == EVENT_NOTE_OFF )
+            timestamp -= c_note_off_margin;
+
+        m_ticks[k] = timestamp % a_length;
+        m_flags[k] |= c_transform_moved;
+    }
+}
+
+void
+eventtransform::reverse( long a_length )
+{
+    size_t count = m_events.size();
+    vector < bool > done( count, false );
+
+    for ( size_t k = 0; k < count; k++ ){
+
+        int p = m_link[k];
+
+        /* only linked notes */
+        if ( p < 0 || done[k] )
+            continue;
+
+        if ( m_status[k] != EVENT_NOTE_ON && m_status[k] != EVENT_NOTE_OFF )
+            continue;
+
+        int pair[2] = { (int) k, p };
+
+        for ( int j = 0; j < 2; j++ ){
+
+            int e = pair[j];
+            long timestamp = m_ticks[e];
+
+            /* note OFFs become note ONs & note ONs become note OFFs */
+            if ( m_status[e] == EVENT_NOTE_OFF ){
+                timestamp += c_note_off_margin;
+                m_status[e] = EVENT_NOTE_ON;
+            }
+            else
+                m_status[e] = EVENT_NOTE_OFF;
+
+            /* calculate the reverse location */
+            double note_ratio = 1.0;
+            note_ratio -= (double) timestamp / a_length;
+
+            timestamp = a_length * note_ratio;
+
+            if ( m_status[e] == EVENT_NOTE_OFF )
+                timestamp -= c_note_off_margin;
+
+            m_ticks[e] = timestamp;
+            m_flags[e] |= c_transform_moved;
+            done[e] = true;
+        }
+
+        /* reverse the velocities also */
+        unsigned char velocity = m_d1[k];
+        m_d1[k] = m_d1[p];
+        m_d1[p] = velocity;
+    }
+}
+
+void
+eventtransform::run( long a_length )
+{
+    for ( size_t i = 0; i < m_steps.size(); i++ ){
+
+        step *s = &m_steps[i];
+
+        switch ( s->m_type ){
+
+            case TRANSFORM_TRANSPOSE:
+                transpose( s );
+                break;
+
+            case TRANSFORM_SHIFT:
+                shift( s, a_length );
+                break;
+
+            case TRANSFORM_QUANTIZE:
+                quantize( s, a_length );
+                break;
+
+            case TRANSFORM_RANDOMIZE:
+                randomize( s );
+                break;
+
+            case TRANSFORM_SCALE:
+                scale( s, a_length );
+                break;
+
+            case TRANSFORM_REVERSE:
+                reverse( a_length );
+                break;
+        }
+    }
+}
+
+void
+eventtransform::store( list<event> *a_moved )
+{
+    size_t count = m_events.size();
+
+    for ( size_t k = 0; k < count; k++ ){
+
+        if ( m_flags[k] & c_transform_moved ){
+
+            event e = *m_events[k];
+
+            e.unmark();
+            e.set_status( m_status[k] );
+            e.set_timestamp( m_ticks[k] );
+            e.set_data( m_d0[k], m_d1[k] );
+            a_moved->push_back( e );
+
+            (*m_events[k]).mark();
+        }
+        else if ( m_flags[k] & c_transform_changed ){
+
+            (*m_events[k]).set_data( m_d0[k], m_d1[k] );
+        }
+    }
+
+    /* stable, moved events at the same tick keep their order */
+    a_moved->sort();
+}
@@ -0,0 +1,134 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef SEQ192_EVENTTRANSFORM
+#define SEQ192_EVENTTRANSFORM
+
+#include <list>
+#include <vector>
+
+#include "event.h"
+#include "globals.h"
+
+enum transform_type
+{
+    TRANSFORM_TRANSPOSE,
+    TRANSFORM_SHIFT,
+    TRANSFORM_QUANTIZE,
+    TRANSFORM_RANDOMIZE,
+    TRANSFORM_SCALE,
+    TRANSFORM_REVERSE
+};
+
+/* a chain of edits applied to the events of a sequence in one go.
+   The events are copied into one array per field, every step of the
+   chain runs over these arrays, then the moved events are put back in
+   order with a single sort and merge (see sequence::apply_transforms) */
+class eventtransform
+{
+
+ public:
+
+    typedef list<event>::iterator iterator;
+
+ private:
+
+    struct step
+    {
+        transform_type m_type;
+        unsigned char m_status;
+        unsigned char m_cc;
+
+        /* steps, ticks, snap or amount depending on the type */
+        long m_value;
+        int m_divide;
+        bool m_linked;
+        float m_multiplier;
+    };
+
+    vector < step > m_steps;
+
+    /* the events being transformed */
+    vector < iterator > m_events;
+    vector < long > m_ticks;
+    vector < unsigned char > m_status;
+    vector < unsigned char > m_d0;
+    vector < unsigned char > m_d1;
+
+    /* position of the linked note event in the arrays, -1 if none */
+    vector < int > m_link;
+
+    vector < unsigned char > m_flags;
+
+    void push( iterator a_e, unsigned char a_flags );
+    void add_step( transform_type a_type, long a_value );
+
+    void transpose( step *a_step );
+    void shift( step *a_step, long a_length );
+    void quantize( step *a_step, long a_length );
+    void randomize( step *a_step );
+    void scale( step *a_step, long a_length );
+    void reverse( long a_length );
+
+ public:
+
+    eventtransform();
+
+    void clear();
+    bool empty();
+
+    /* transpose notes and aftertouch */
+    void add_transpose( int a_steps );
+
+    /* move events, wrapping around the sequence length */
+    void add_shift( long a_ticks );
+
+    /* move events of a_status (and a_cc for control changes) towards
+       the a_snap_tick grid, note offs follow their note ons if
+       a_linked is set */
+    void add_quantize( unsigned char a_status, unsigned char a_cc,
+                       long a_snap_tick, int a_divide, bool a_linked );
+
+    /* randomize the value of a_status events by +/- a_amount */
+    void add_randomize( unsigned char a_status, int a_amount );
+
+    /* stretch the timestamps of all events */
+    void add_scale( float a_multiplier );
+
+    /* reverse the notes in time */
+    void add_reverse();
+
+    /* ratio between the sequence lengths after and before the chain */
+    float get_length_ratio();
+
+    /* parses a chain such as "quantize 48; transpose -12", returns
+       false if a step is unknown or misses arguments */
+    bool parse( const char *a_chain );
+
+    /* copies the events to transform: the selected ones, or all of
+       them, plus the note events linked to these */
+    void load( list<event> *a_list, bool a_selected );
+
+    /* runs the chain over the loaded events */
+    void run( long a_length );
+
+    /* writes value changes back in place, marks the events that were
+       moved and fills a_moved with their sorted new versions */
+    void store( list<event> *a_moved );
+};
+
+#endif
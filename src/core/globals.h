@@ -18,6 +18,7 @@
 #define SEQ192_GLOBALS
 
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -78,7 +79,29 @@ extern string global_client_name;
 extern bool global_with_jack_transport;
 extern char* global_oscport;
 
+/* subtracted from the arrival time of recorded events */
+extern long global_input_latency_us;
+
+/* recorded controller thinning, see eventthinner */
+extern long global_thin_spacing;
+extern bool global_thin_repeats;
+extern int global_thin_tolerance;
+
+/* what to do with osc bundles whose timetag has passed */
+enum late_bundle_e
+{
+    E_LATE_BUNDLE_NOW,
+    E_LATE_BUNDLE_BAR,
+    E_LATE_BUNDLE_DROP
+};
+
+extern late_bundle_e global_late_bundles;
+
 extern bool global_is_modified;
+
+/* keep an edit journal next to the session file, see journal.h */
+extern bool global_journal;
+
 extern bool global_is_running;
 
 extern string global_filename;
@@ -113,6 +136,20 @@ extern user_midi_bus_definition   global_user_midi_bus_definitions[c_maxBuses];
 extern user_instrument_definition global_user_instrument_definitions[c_max_instruments];
 extern user_keymap_definition     global_user_keymap_definitions[c_max_instruments];
 
+/* control surface mapping from the config file, see midicontrol */
+struct user_midi_control
+{
+    int channel;
+    int entry;
+    string action;
+    int value;
+};
+
+extern vector<user_midi_control> global_user_midi_controls;
+
+/* bus receiving the control surface feedback, -1 for none */
+extern int global_control_feedback_bus;
+
 enum file_type_e
 {
     E_MIDI_SEQ192_SESSION,
@@ -0,0 +1,420 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+#include "journal.h"
+#include "midifile.h"
+#include "perform.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void
+put_long( vector < unsigned char > *a_buffer, unsigned long a_x )
+{
+    a_buffer->push_back( (a_x & 0xFF000000) >> 24 );
+    a_buffer->push_back( (a_x & 0x00FF0000) >> 16 );
+    a_buffer->push_back( (a_x & 0x0000FF00) >> 8 );
+    a_buffer->push_back( (a_x & 0x000000FF) );
+}
+
+static void
+put_short( vector < unsigned char > *a_buffer, unsigned short a_x )
+{
+    a_buffer->push_back( (a_x & 0xFF00) >> 8 );
+    a_buffer->push_back( (a_x & 0x00FF) );
+}
+
+static unsigned long
+get_long( unsigned char *a_d )
+{
+    return ((unsigned long) a_d[0] << 24) | (a_d[1] << 16) | (a_d[2] << 8) | a_d[3];
+}
+
+static unsigned short
+get_short( unsigned char *a_d )
+{
+    return (a_d[0] << 8) | a_d[1];
+}
+
+journal::journal()
+{
+    m_fd = -1;
+    m_old_fd = -1;
+    m_size = 0;
+}
+
+journal::~journal()
+{
+    close( false );
+}
+
+/* magic, version, then the size and modification time of the session */
+bool
+journal::header( const string &a_session, vector < unsigned char > *a_buffer )
+{
+    struct stat st;
+
+    if ( stat( a_session.c_str(), &st ) < 0 )
+        return false;
+
+    uint64_t size = st.st_size;
+    uint64_t sec = st.st_mtim.tv_sec;
+
+    put_long( a_buffer, c_journal_magic );
+    put_long( a_buffer, c_journal_version );
+    put_long( a_buffer, size >> 32 );
+    put_long( a_buffer, size & 0xFFFFFFFF );
+    put_long( a_buffer, sec >> 32 );
+    put_long( a_buffer, sec & 0xFFFFFFFF );
+    put_long( a_buffer, st.st_mtim.tv_nsec );
+
+    return true;
+}
+
+bool
+journal::read_file( const string &a_name, vector < unsigned char > *a_data )
+{
+    int fd = ::open( a_name.c_str(), O_RDONLY );
+
+    if ( fd < 0 )
+        return false;
+
+    unsigned char chunk[0x10000];
+    ssize_t n;
+
+    while (( n = read( fd, chunk, sizeof( chunk ))) != 0 ){
+
+        if ( n < 0 && errno == EINTR )
+            continue;
+
+        if ( n < 0 )
+            break;
+
+        a_data->insert( a_data->end(), chunk, chunk + n );
+    }
+
+    ::close( fd );
+
+    return n == 0;
+}
+
+/* records: type, length, then length bytes */
+size_t
+journal::scan( vector < unsigned char > *a_data, size_t a_pos )
+{
+    while ( a_data->size() - a_pos >= 5 ){
+
+        unsigned long length = get_long( &(*a_data)[a_pos + 1] );
+
+        if ( length > a_data->size() - a_pos - 5 )
+            break;
+
+        a_pos += 5 + length;
+    }
+
+    return a_pos;
+}
+
+bool
+journal::open( const string &a_session, bool a_truncate )
+{
+    close( false );
+
+    vector < unsigned char > head;
+
+    if ( !header( a_session, &head ))
+        return false;
+
+    m_session = a_session;
+    m_name = a_session + ".journal";
+
+    /* an existing journal is kept if it belongs to this file, minus
+       a record a crash may have cut short */
+    size_t keep = 0;
+
+    if ( !a_truncate ){
+
+        vector < unsigned char > data;
+
+        if ( read_file( m_name, &data ) &&
+             data.size() >= head.size() &&
+             memcmp( data.data(), head.data(), head.size() ) == 0 )
+        {
+            keep = scan( &data, head.size() );
+        }
+    }
+
+    m_fd = ::open( m_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | (keep == 0 ? O_TRUNC : 0), 0666 );
+
+    if ( m_fd < 0 ){
+        fprintf( stderr, "Error opening %s: %s\n", m_name.c_str(), strerror( errno ));
+        return false;
+    }
+
+    if ( keep > 0 && ftruncate( m_fd, keep ) < 0 ){
+        fprintf( stderr, "Error truncating %s: %s\n", m_name.c_str(), strerror( errno ));
+        close( false );
+        return false;
+    }
+
+    m_buffer.clear();
+    m_size = keep;
+
+    if ( keep == 0 ){
+        m_buffer = head;
+        m_size = head.size();
+    }
+
+    return flush();
+}
+
+void
+journal::close( bool a_remove )
+{
+    if ( m_fd < 0 )
+        return;
+
+    if ( !a_remove )
+        flush();
+
+    ::close( m_fd );
+    m_fd = -1;
+
+    if ( a_remove )
+        unlink( m_name.c_str() );
+
+    m_buffer.clear();
+    m_size = 0;
+    m_session = "";
+}
+
+bool
+journal::is_open()
+{
+    return m_fd >= 0;
+}
+
+const string &
+journal::get_session()
+{
+    return m_session;
+}
+
+size_t
+journal::get_size()
+{
+    return m_size;
+}
+
+void
+journal::begin_record( unsigned char a_type, size_t a_length )
+{
+    m_buffer.push_back( a_type );
+    put_long( &m_buffer, a_length );
+
+    m_size += 5 + a_length;
+}
+
+void
+journal::add_clear()
+{
+    begin_record( E_JOURNAL_CLEAR, 0 );
+}
+
+void
+journal::add_track( int a_seq, vector < unsigned char > *a_data )
+{
+    begin_record( E_JOURNAL_TRACK, 2 + a_data->size() );
+    put_short( &m_buffer, a_seq );
+    m_buffer.insert( m_buffer.end(), a_data->begin(), a_data->end() );
+}
+
+void
+journal::add_delete( int a_seq )
+{
+    begin_record( E_JOURNAL_DELETE, 2 );
+    put_short( &m_buffer, a_seq );
+}
+
+void
+journal::add_bpm( double a_bpm )
+{
+    begin_record( E_JOURNAL_BPM, 4 );
+    put_long( &m_buffer, (unsigned long) (a_bpm * c_bpm_scale_factor) );
+}
+
+void
+journal::add_notes( int a_set, const string &a_notes )
+{
+    begin_record( E_JOURNAL_NOTES, 2 + a_notes.size() );
+    put_short( &m_buffer, a_set );
+    m_buffer.insert( m_buffer.end(), a_notes.begin(), a_notes.end() );
+}
+
+/* no sync: the journal is there for crashes of seq192, the kernel
+   still writes it out if the process dies */
+bool
+journal::flush()
+{
+    size_t written = 0;
+
+    while ( written < m_buffer.size() ){
+
+        ssize_t n = write( m_fd, m_buffer.data() + written, m_buffer.size() - written );
+
+        if ( n < 0 && errno == EINTR )
+            continue;
+
+        if ( n < 0 ){
+            fprintf( stderr, "Error writing %s: %s\n", m_name.c_str(), strerror( errno ));
+            m_buffer.erase( m_buffer.begin(), m_buffer.begin() + written );
+            return false;
+        }
+
+        written += n;
+    }
+
+    m_buffer.clear();
+
+    return true;
+}
+
+bool
+journal::begin_rewrite()
+{
+    vector < unsigned char > head;
+
+    if ( !flush() || !header( m_session, &head ))
+        return false;
+
+    string tmp_name = m_name + ".tmp";
+    int fd = ::open( tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666 );
+
+    if ( fd < 0 ){
+        fprintf( stderr, "Error opening %s: %s\n", tmp_name.c_str(), strerror( errno ));
+        return false;
+    }
+
+    m_old_fd = m_fd;
+    m_fd = fd;
+
+    m_buffer = head;
+    m_size = head.size();
+
+    return true;
+}
+
+/* the old journal stays in place until the new one is complete. If
+   that fails the journal is closed: what it holds no longer matches
+   what the records were compared against */
+bool
+journal::end_rewrite()
+{
+    string tmp_name = m_name + ".tmp";
+
+    if ( !flush() || rename( tmp_name.c_str(), m_name.c_str() ) != 0 ){
+
+        fprintf( stderr, "Error replacing %s, journal stopped\n", m_name.c_str() );
+
+        unlink( tmp_name.c_str() );
+        ::close( m_fd );
+        m_fd = m_old_fd;
+        m_old_fd = -1;
+        close( false );
+
+        return false;
+    }
+
+    ::close( m_old_fd );
+    m_old_fd = -1;
+
+    return true;
+}
+
+int
+journal::replay( const string &a_session, perform *a_perf )
+{
+    vector < unsigned char > head;
+    vector < unsigned char > data;
+
+    if ( !header( a_session, &head ) ||
+         !read_file( a_session + ".journal", &data ) ||
+         data.size() < head.size() ||
+         memcmp( data.data(), head.data(), head.size() ) != 0 )
+    {
+        return -1;
+    }
+
+    midifile loader( a_session );
+
+    size_t pos = head.size();
+    size_t end = scan( &data, pos );
+    int count = 0;
+
+    while ( pos < end ){
+
+        unsigned char type = data[pos];
+        unsigned long length = get_long( &data[pos + 1] );
+        unsigned char *d = &data[pos + 5];
+
+        pos += 5 + length;
+        count++;
+
+        if ( type == E_JOURNAL_CLEAR ){
+
+            string empty( "" );
+
+            for ( int i = 0; i < c_max_sequence; i++ ){
+                if ( a_perf->is_active( i ))
+                    a_perf->delete_sequence( i );
+            }
+
+            for ( int i = 0; i < c_max_sets; i++ )
+                a_perf->set_screen_set_notepad( i, &empty );
+        }
+        else if ( type == E_JOURNAL_TRACK && length >= 2 && get_short( d ) < c_max_sequence ){
+
+            if ( !loader.load_track( a_perf, d + 2, length - 2, get_short( d )))
+                fprintf( stderr, "Journal: bad track for sequence %d\n", get_short( d ));
+        }
+        else if ( type == E_JOURNAL_DELETE && length >= 2 && get_short( d ) < c_max_sequence ){
+
+            if ( a_perf->is_active( get_short( d )))
+                a_perf->delete_sequence( get_short( d ));
+        }
+        else if ( type == E_JOURNAL_BPM && length >= 4 ){
+
+            a_perf->set_bpm( get_long( d ) / c_bpm_scale_factor );
+        }
+        else if ( type == E_JOURNAL_NOTES && length >= 2 && get_short( d ) < c_max_sets ){
+
+            string notes( (char *) d + 2, length - 2 );
+            a_perf->set_screen_set_notepad( get_short( d ), &notes );
+        }
+        else {
+            /* unknown or malformed, skipped */
+            count--;
+        }
+    }
+
+    return count;
+}
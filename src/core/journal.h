@@ -0,0 +1,124 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+#ifndef SEQ192_JOURNAL
+#define SEQ192_JOURNAL
+
+#include <string>
+#include <vector>
+
+#include "globals.h"
+
+class perform;
+
+/* "S19J" */
+const unsigned long c_journal_magic = 0x5331394A;
+const unsigned long c_journal_version = 1;
+
+/* the journal is rewritten as a full snapshot past this size */
+const size_t c_journal_compact = 0x800000;
+
+/* edits are collected and written at this period */
+const long c_journal_period_us = 1000000;
+
+enum journal_record_e {
+    /* drops every sequence and notepad, starts a snapshot */
+    E_JOURNAL_CLEAR = 1,
+    /* sequence number, then the track as written by fill_buffer */
+    E_JOURNAL_TRACK,
+    /* sequence number */
+    E_JOURNAL_DELETE,
+    /* bpm * c_bpm_scale_factor */
+    E_JOURNAL_BPM,
+    /* screen set, then the notepad text */
+    E_JOURNAL_NOTES
+};
+
+/* append-only log of the edits made since a session file was saved,
+   kept next to it (<session>.journal) and replayed over it after a
+   crash. The header records the size and time of the session file
+   it applies to, a journal left by another version of the file is
+   ignored. Records are buffered and written by flush(), only the
+   journal thread of perform writes it. */
+class journal
+{
+
+ private:
+
+    string m_name;
+    string m_session;
+    int m_fd;
+
+    /* journal being replaced during a rewrite */
+    int m_old_fd;
+
+    /* records not written yet */
+    vector < unsigned char > m_buffer;
+    size_t m_size;
+
+    /* header for a_session as it is on disk, false if it is missing */
+    static bool header( const string &a_session, vector < unsigned char > *a_buffer );
+
+    static bool read_file( const string &a_name, vector < unsigned char > *a_data );
+
+    /* end of the last complete record of a_data from a_pos, a crash
+       can leave the last one cut short */
+    static size_t scan( vector < unsigned char > *a_data, size_t a_pos );
+
+    void begin_record( unsigned char a_type, size_t a_length );
+
+ public:
+
+    journal();
+    ~journal();
+
+    /* starts the journal of a_session, over any existing one if
+       a_truncate or if the existing one does not belong to it */
+    bool open( const string &a_session, bool a_truncate );
+
+    /* a_remove deletes the file: the session was saved or left */
+    void close( bool a_remove );
+
+    bool is_open();
+    const string &get_session();
+
+    /* bytes in the file, buffered ones included */
+    size_t get_size();
+
+    void add_clear();
+    void add_track( int a_seq, vector < unsigned char > *a_data );
+    void add_delete( int a_seq );
+    void add_bpm( double a_bpm );
+    void add_notes( int a_set, const string &a_notes );
+
+    /* writes the buffered records in one go */
+    bool flush();
+
+    /* restarts the file with a snapshot: after begin_rewrite() the
+       records go to a new file, replacing the journal on
+       end_rewrite() */
+    bool begin_rewrite();
+    bool end_rewrite();
+
+    /* applies the journal of a_session to a_perf, returns the number
+       of records applied or -1 if there is no journal for this
+       version of the file */
+    static int replay( const string &a_session, perform *a_perf );
+};
+
+#endif
@@ -16,6 +16,8 @@
 
 #include "midibus.h"
 #include <sys/poll.h>
+#include <sys/timerfd.h>
+#include <time.h>
 
 midibus::midibus( int a_localclient,
 		  int a_destclient,
@@ -35,6 +37,9 @@ midibus::midibus( int a_localclient,
     m_id = a_id;
     m_inputing = false;
 
+    m_sysex_sent = 0;
+    m_sysex_next_us = 0;
+
 
     char name[60];
     if ( global_user_midi_bus_definitions[m_id].alias.length() > 0 )
@@ -69,6 +74,9 @@ midibus::midibus( int a_localclient,
     m_id = a_id;
     m_inputing = false;
 
+    m_sysex_sent = 0;
+    m_sysex_next_us = 0;
+
 
 	char name[60];
     if ( m_id > 0 && global_user_midi_bus_definitions[m_id - 1].alias.length() > 0 )
@@ -192,9 +200,10 @@ bool midibus::init_in( )
     snd_seq_port_subscribe_set_sender(subs, &sender);
     snd_seq_port_subscribe_set_dest(subs, &dest);
 
-    /* use the master queue, and get ticks */
+    /* use the master queue, and get real time */
     snd_seq_port_subscribe_set_queue(subs, m_queue);
     snd_seq_port_subscribe_set_time_update(subs, 1);
+    snd_seq_port_subscribe_set_time_real(subs, 1);
 
     /* subscribe */
     ret = snd_seq_subscribe_port(m_seq, subs);
@@ -225,6 +234,18 @@ bool midibus::init_in_sub( )
         printf( "snd_seq_create_simple_port(write) error\n");
         return false;
     }
+
+    /* stamp whatever gets connected to us with the master queue's
+       real time */
+    snd_seq_port_info_t *pinfo;
+    snd_seq_port_info_alloca(&pinfo);
+
+    snd_seq_get_port_info(m_seq, m_local_addr_port, pinfo);
+    snd_seq_port_info_set_timestamping(pinfo, 1);
+    snd_seq_port_info_set_timestamp_real(pinfo, 1);
+    snd_seq_port_info_set_timestamp_queue(pinfo, m_queue);
+    snd_seq_set_port_info(m_seq, m_local_addr_port, pinfo);
+
     return true;
 }
 
@@ -248,9 +269,10 @@ bool midibus::deinit_in( )
     snd_seq_port_subscribe_set_sender(subs, &sender);
     snd_seq_port_subscribe_set_dest(subs, &dest);
 
-    /* use the master queue, and get ticks */
+    /* use the master queue, and get real time */
     snd_seq_port_subscribe_set_queue(subs, m_queue);
     snd_seq_port_subscribe_set_time_update(subs, 1);
+    snd_seq_port_subscribe_set_time_real(subs, 1);
 
     /* subscribe */
     ret = snd_seq_unsubscribe_port(m_seq, subs);
@@ -294,8 +316,21 @@ midibus::~midibus()
 void
 midibus::play( event *a_e24, unsigned char a_channel )
 {
+    if ( a_e24->get_status() == EVENT_SYSEX ){
+        sysex( a_e24 );
+        return;
+    }
+
     lock();
 
+    /* don't break into the sysex being sent */
+    if ( m_sysex_sent < m_sysex_pending.size() ){
+
+        m_sysex_deferred.push_back( make_pair( *a_e24, a_channel ));
+        unlock();
+        return;
+    }
+
 	snd_seq_event_t ev;
 
 	/* alsa midi parser */
@@ -340,43 +375,151 @@ min ( long a, long b ){
     return b;
 }
 
-/* takes an native event, encodes to alsa event,
-   puts it in the queue */
+static long long
+monotonic_us()
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* takes an native event, queues its sysex data for
+   send_sysex() */
 void
 midibus::sysex( event *a_e24 )
 {
     lock();
 
-    snd_seq_event_t ev;
+    unsigned char *data = a_e24->get_sysex();
+    long data_size =  a_e24->get_size();
 
-    /* clear event */
-    snd_seq_ev_clear( &ev );
-    snd_seq_ev_set_priority( &ev, 1 );
+    if ( data_size > 0 ){
 
-    /* set source */
-    snd_seq_ev_set_source(&ev, m_local_addr_port );
-    snd_seq_ev_set_subs(&ev);
+        if ( m_sysex_sent < m_sysex_pending.size() ){
 
-    // its immediate
-    snd_seq_ev_set_direct( &ev );
+            /* one at a time */
+            m_sysex_deferred.push_back( make_pair( *a_e24, 0 ));
+        }
+        else {
 
-    unsigned char *data = a_e24->get_sysex();
-    long data_size =  a_e24->get_size();
+            m_sysex_pending.assign( data, data + data_size );
+            m_sysex_sent = 0;
 
-    for (long offset = 0; offset < data_size;
-            offset += c_midibus_sysex_chunk) {
+            send_sysex();
+        }
+    }
 
-        long data_left = data_size - offset;
+    unlock();
+}
 
-        snd_seq_ev_set_sysex( &ev,
-                min( data_left, c_midibus_sysex_chunk),
-                &data[offset] );
+
+/* puts the chunks of the pending sysex that are due in the queue,
+   then the events held back behind it */
+void
+midibus::send_sysex()
+{
+    lock();
+
+    while ( m_sysex_sent < m_sysex_pending.size() ){
+
+        long long now = monotonic_us();
+
+        if ( now < m_sysex_next_us )
+            break;
+
+        long data_left = m_sysex_pending.size() - m_sysex_sent;
+        long chunk = min( data_left, c_midibus_sysex_chunk );
+
+        snd_seq_event_t ev;
+
+        /* clear event */
+        snd_seq_ev_clear( &ev );
+        snd_seq_ev_set_priority( &ev, 1 );
+
+        /* set source */
+        snd_seq_ev_set_source(&ev, m_local_addr_port );
+        snd_seq_ev_set_subs(&ev);
+
+        // its immediate
+        snd_seq_ev_set_direct( &ev );
+
+        snd_seq_ev_set_sysex( &ev, chunk, &m_sysex_pending[m_sysex_sent] );
 
         /* pump it into the queue */
-        snd_seq_event_output_direct(m_seq, &ev);
-        usleep(80000);
-        flush();
+        snd_seq_event_output( m_seq, &ev );
+
+        m_sysex_sent += chunk;
+        m_sysex_next_us = now + chunk * 1000000 / c_midibus_sysex_rate;
+
+        /* play what waited, up to the next sysex */
+        while ( m_sysex_sent == m_sysex_pending.size() &&
+                !m_sysex_deferred.empty() ){
+
+            pair < event, unsigned char > deferred = m_sysex_deferred.front();
+            m_sysex_deferred.pop_front();
+
+            if ( deferred.first.get_status() == EVENT_SYSEX ){
+
+                m_sysex_pending.assign( deferred.first.get_sysex(),
+                        deferred.first.get_sysex() + deferred.first.get_size() );
+                m_sysex_sent = 0;
+            }
+            else {
+                play( &deferred.first, deferred.second );
+            }
+        }
     }
+
+    unlock();
+}
+
+bool
+midibus::get_sysex_due( long long *a_us )
+{
+    lock();
+
+    bool pending = m_sysex_sent < m_sysex_pending.size();
+    if ( pending )
+        *a_us = m_sysex_next_us;
+
+    unlock();
+
+    return pending;
+}
+
+void
+midibus::abort_sysex()
+{
+    lock();
+
+    /* a receiver left in the middle of a message needs its end */
+    if ( m_sysex_sent > 0 && m_sysex_sent < m_sysex_pending.size() ){
+
+        unsigned char end = EVENT_SYSEX_END;
+        snd_seq_event_t ev;
+
+        snd_seq_ev_clear( &ev );
+        snd_seq_ev_set_priority( &ev, 1 );
+        snd_seq_ev_set_source(&ev, m_local_addr_port );
+        snd_seq_ev_set_subs(&ev);
+        snd_seq_ev_set_direct( &ev );
+        snd_seq_ev_set_sysex( &ev, 1, &end );
+        snd_seq_event_output( m_seq, &ev );
+    }
+
+    m_sysex_pending.clear();
+    m_sysex_sent = 0;
+
+    list < pair < event, unsigned char > > deferred;
+    deferred.swap( m_sysex_deferred );
+
+    list < pair < event, unsigned char > >::iterator i;
+    for ( i = deferred.begin(); i != deferred.end(); i++ ){
+        if ( i->first.get_status() != EVENT_SYSEX )
+            play( &i->first, i->second );
+    }
+
     unlock();
 }
 
@@ -386,6 +529,7 @@ void
 midibus::flush()
 {
     lock();
+    send_sysex();
     snd_seq_drain_output( m_seq );
     unlock();
 }
@@ -417,7 +561,10 @@ midibus::get_input( )
 void
 mastermidibus::lock( )
 {
-   m_mutex.lock();
+   if ( !m_mutex.try_lock() ){
+       m_lock_waits++;
+       m_mutex.lock();
+   }
 }
 
 
@@ -428,6 +575,23 @@ mastermidibus::unlock( )
 }
 
 
+void
+mastermidibus::lock_input( )
+{
+   if ( !m_input_mutex.try_lock() ){
+       m_input_lock_waits++;
+       m_input_mutex.lock();
+   }
+}
+
+
+void
+mastermidibus::unlock_input( )
+{
+   m_input_mutex.unlock();
+}
+
+
 void
 mastermidibus::set_ppqn( int a_ppqn )
 {
@@ -480,8 +644,60 @@ mastermidibus::flush()
 {
     lock();
 
+    for ( int i=0; i<m_num_out_buses; i++ )
+        m_buses_out[i]->send_sysex();
+
     snd_seq_drain_output( m_alsa_seq );
 
+    arm_sysex_timer();
+
+    unlock();
+}
+
+/* one shot at the earliest chunk due, only rearmed when that moves */
+void
+mastermidibus::arm_sysex_timer()
+{
+    if ( m_sysex_timer < 0 )
+        return;
+
+    long long due = 0;
+
+    for ( int i=0; i<m_num_out_buses; i++ ){
+        long long us;
+        if ( m_buses_out[i]->get_sysex_due( &us ) && (due == 0 || us < due) )
+            due = us;
+    }
+
+    if ( due == m_sysex_timer_us )
+        return;
+
+    /* 0 disarms it, a due time already past fires at once */
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = 0;
+    spec.it_value.tv_sec = due / 1000000;
+    spec.it_value.tv_nsec = (due % 1000000) * 1000;
+
+    if ( due > 0 && spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0 )
+        spec.it_value.tv_nsec = 1;
+
+    if ( timerfd_settime( m_sysex_timer, TFD_TIMER_ABSTIME, &spec, NULL ) == 0 )
+        m_sysex_timer_us = due;
+}
+
+void
+mastermidibus::abort_sysex()
+{
+    lock();
+
+    for ( int i=0; i<m_num_out_buses; i++ )
+        m_buses_out[i]->abort_sysex();
+
+    snd_seq_drain_output( m_alsa_seq );
+
+    arm_sysex_timer();
+
     unlock();
 }
 
@@ -505,8 +721,23 @@ mastermidibus::mastermidibus()
         m_init_input[i] = false;
     }
 
-    /* open the sequencer client */
-    ret = snd_seq_open(&m_alsa_seq, "default",  SND_SEQ_OPEN_DUPLEX, 0);
+    m_lock_waits = 0;
+    m_input_lock_waits = 0;
+
+    m_sysex_timer_us = 0;
+    m_sysex_timer = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK );
+    if ( m_sysex_timer < 0 )
+        printf( "timerfd_create() error, sysex only goes out with playback\n" );
+
+    /* open the sequencer clients */
+    ret = snd_seq_open(&m_alsa_seq, "default",  SND_SEQ_OPEN_OUTPUT, 0);
+
+    if ( ret < 0 ){
+	printf( "snd_seq_open() error\n");
+	exit(1);
+    }
+
+    ret = snd_seq_open(&m_alsa_seq_in, "default",  SND_SEQ_OPEN_INPUT, 0);
 
     if ( ret < 0 ){
 	printf( "snd_seq_open() error\n");
@@ -515,9 +746,15 @@ mastermidibus::mastermidibus()
 
     /* set our clients name */
     snd_seq_set_client_name(m_alsa_seq, global_client_name.c_str());
+    snd_seq_set_client_name(m_alsa_seq_in, global_client_name.c_str());
+
+    /* input decoder, always writes the status byte */
+    snd_midi_event_new( c_midibus_decode_size, &m_midi_decoder );
+    snd_midi_event_no_status( m_midi_decoder, 1 );
 
-    /* set up our clients queue */
+    /* set up our clients queue, input is stamped against it */
     m_queue = snd_seq_alloc_queue( m_alsa_seq );
+    snd_seq_set_queue_usage( m_alsa_seq_in, m_queue, 1 );
 }
 
 
@@ -547,8 +784,8 @@ mastermidibus::init( )
 
     /* only one in */
     m_buses_in[0] =
-        new midibus( snd_seq_client_id( m_alsa_seq ),
-                m_alsa_seq,
+        new midibus( snd_seq_client_id( m_alsa_seq_in ),
+                m_alsa_seq_in,
                 m_num_in_buses, m_queue);
 
     m_buses_in[0]->init_in_sub();
@@ -560,33 +797,44 @@ mastermidibus::init( )
     set_bpm( c_bpm );
     set_ppqn( c_ppqn );
 
+    /* run the queue for input timestamps, and see where its
+       clock stands against ours */
+    snd_seq_start_queue( m_alsa_seq, m_queue, NULL );
+    snd_seq_drain_output( m_alsa_seq );
+
+    snd_seq_queue_status_t *status;
+    snd_seq_queue_status_alloca( &status );
+    snd_seq_get_queue_status( m_alsa_seq, m_queue, status );
+
+    const snd_seq_real_time_t *queue_time = snd_seq_queue_status_get_real_time( status );
+    m_queue_offset_us = monotonic_us() -
+        ((long long) queue_time->tv_sec * 1000000 + queue_time->tv_nsec / 1000);
+
     /* midi input */
     /* poll descriptors */
 
     /* get number of file descriptors */
-    m_num_poll_descriptors = snd_seq_poll_descriptors_count(m_alsa_seq, POLLIN);
+    m_num_poll_descriptors = snd_seq_poll_descriptors_count(m_alsa_seq_in, POLLIN);
 
     /* allocate into */
     m_poll_descriptors = new pollfd[m_num_poll_descriptors];
 
     /* get descriptors */
-    snd_seq_poll_descriptors(m_alsa_seq,
+    snd_seq_poll_descriptors(m_alsa_seq_in,
             m_poll_descriptors,
             m_num_poll_descriptors,
             POLLIN);
 
-    m_seq = NULL;
-
     /* sizes */
     snd_seq_set_output_buffer_size(m_alsa_seq, c_midibus_output_size );
-    snd_seq_set_input_buffer_size(m_alsa_seq, c_midibus_input_size );
+    snd_seq_set_input_buffer_size(m_alsa_seq_in, c_midibus_input_size );
 
 
     m_bus_announce =
-        new midibus( snd_seq_client_id( m_alsa_seq ),
+        new midibus( snd_seq_client_id( m_alsa_seq_in ),
                 SND_SEQ_CLIENT_SYSTEM,
                 SND_SEQ_PORT_SYSTEM_ANNOUNCE,
-                m_alsa_seq,
+                m_alsa_seq_in,
                 "system", "annouce",
                 0, m_queue);
 
@@ -607,7 +855,13 @@ mastermidibus::~mastermidibus()
     snd_seq_stop_queue( m_alsa_seq, m_queue, &ev );
     snd_seq_free_queue( m_alsa_seq, m_queue );
 
-    /* close client */
+    snd_midi_event_free( m_midi_decoder );
+
+    if ( m_sysex_timer >= 0 )
+        close( m_sysex_timer );
+
+    /* close clients */
+    snd_seq_close( m_alsa_seq_in );
     snd_seq_close( m_alsa_seq );
 }
 
@@ -631,30 +885,110 @@ void
 mastermidibus::play( unsigned char a_bus, event *a_e24, unsigned char a_channel )
 {
 	lock();
-	if ( m_buses_out_active[a_bus] && a_bus < m_num_out_buses ){
+	if ( a_bus < m_num_out_buses && m_buses_out_active[a_bus] ){
 		m_buses_out[a_bus]->play( a_e24, a_channel );
 	}
 	unlock();
 }
 
+bool
+mastermidibus::play_thru( sequence *a_seq, event *a_e )
+{
+    lock_input();
+
+    /* disarming or deleting a_seq removes it from the router first */
+    if ( !m_router.has( a_seq ) || !a_seq->get_thru() ){
+        unlock_input();
+        return false;
+    }
+
+    thru_note held;
+    held.m_seq = a_seq;
+    held.m_bus = a_seq->get_midi_bus();
+    held.m_channel = a_seq->get_midi_channel();
+    held.m_note = a_e->get_note();
+
+    bool skip = false;
+
+    m_thru_mutex.lock();
+
+    if ( a_e->is_note_on() ){
+        m_thru_notes.push_back( held );
+    }
+    else if ( a_e->is_note_off() ){
+
+        skip = true;
+
+        for ( size_t i = 0; i < m_thru_notes.size(); i++ ){
+            if ( m_thru_notes[i].m_seq == a_seq &&
+                 m_thru_notes[i].m_bus == held.m_bus &&
+                 m_thru_notes[i].m_channel == held.m_channel &&
+                 m_thru_notes[i].m_note == held.m_note ){
+                m_thru_notes.erase( m_thru_notes.begin() + i );
+                skip = false;
+                break;
+            }
+        }
+    }
+
+    if ( !skip )
+        play( held.m_bus, a_e, held.m_channel );
+
+    m_thru_mutex.unlock();
+
+    unlock_input();
+
+    return true;
+}
+
+void
+mastermidibus::off_thru_notes( sequence *a_seq )
+{
+    m_thru_mutex.lock();
+
+    size_t kept = 0;
+
+    for ( size_t i = 0; i < m_thru_notes.size(); i++ ){
+
+        if ( a_seq != NULL && m_thru_notes[i].m_seq != a_seq ){
+            m_thru_notes[kept++] = m_thru_notes[i];
+            continue;
+        }
+
+        event e;
+        e.set_status( EVENT_NOTE_OFF );
+        e.set_data( m_thru_notes[i].m_note, 0 );
+
+        play( m_thru_notes[i].m_bus, &e, m_thru_notes[i].m_channel );
+    }
+
+    bool sent = kept < m_thru_notes.size();
+    m_thru_notes.resize( kept );
+
+    m_thru_mutex.unlock();
+
+    if ( sent )
+        flush();
+}
+
 void
 mastermidibus::set_input( unsigned char a_bus, bool a_inputing )
 {
-    lock();
+    lock_input();
     if ( a_bus < c_maxBuses ){
         m_init_input[a_bus] = a_inputing;
     }
 
-    if ( m_buses_in_active[a_bus] && a_bus < m_num_in_buses ){
+    if ( a_bus < m_num_in_buses && m_buses_in_active[a_bus] ){
         m_buses_in[a_bus]->set_input( a_inputing );
     }
-    unlock();
+    unlock_input();
 }
 
 bool
 mastermidibus::get_input( unsigned char a_bus )
 {
-	if ( m_buses_in_active[a_bus] && a_bus < m_num_in_buses ){
+	if ( a_bus < m_num_in_buses && m_buses_in_active[a_bus] ){
 		return m_buses_in[a_bus]->get_input();
 	}
 	return false;
@@ -664,7 +998,7 @@ mastermidibus::get_input( unsigned char a_bus )
 string
 mastermidibus::get_midi_out_bus_name( int a_bus )
 {
-	if ( m_buses_out_active[a_bus] && a_bus < m_num_out_buses ){
+	if ( a_bus < m_num_out_buses && m_buses_out_active[a_bus] ){
 		return m_buses_out[a_bus]->get_name();
 	}
 
@@ -690,7 +1024,7 @@ mastermidibus::get_midi_out_bus_name( int a_bus )
 string
 mastermidibus::get_midi_in_bus_name( int a_bus )
 {
-	if ( m_buses_in_active[a_bus] && a_bus < m_num_in_buses ){
+	if ( a_bus < m_num_in_buses && m_buses_in_active[a_bus] ){
 		return m_buses_in[a_bus]->get_name();
 	}
 
@@ -737,111 +1071,179 @@ mastermidibus::get_num_in_buses()
 }
 
 int
-mastermidibus::poll_for_midi( )
+mastermidibus::get_poll_descriptors( struct pollfd **a_fds )
 {
-    int ret = 0;
+    *a_fds = m_poll_descriptors;
 
-    ret = poll( m_poll_descriptors,
-		 m_num_poll_descriptors,
-		 1000);
-
-    return ret;
+    return m_num_poll_descriptors;
 }
 
 bool
 mastermidibus::is_more_input( ){
 
-    lock();
+    lock_input();
 
     int size=0;
 
-    size = snd_seq_event_input_pending(m_alsa_seq, 0);
+    size = snd_seq_event_input_pending(m_alsa_seq_in, 0);
 
-    unlock();
+    unlock_input();
 
     return ( size > 0 );
 }
 
 
 bool
-mastermidibus::get_midi_event( event *a_in )
+mastermidibus::get_midi_event( event *a_in, long long *a_time_us,
+                               vector < sequence * > *a_targets )
 {
-    lock();
+    lock_input();
 
     snd_seq_event_t *ev;
 
-    bool sysex = false;
-
     /* temp for midi data */
-    unsigned char buffer[0x1000];
+    unsigned char buffer[c_midibus_decode_size] = { 0 };
+
+    if ( snd_seq_event_input(m_alsa_seq_in, &ev) < 0 ){
+        unlock_input();
+        return false;
+    }
+
+    /* arrival time, on the monotonic clock */
+    if ( (ev->flags & SND_SEQ_TIME_STAMP_MASK) == SND_SEQ_TIME_STAMP_REAL ){
+        *a_time_us = m_queue_offset_us +
+            (long long) ev->time.time.tv_sec * 1000000 + ev->time.time.tv_nsec / 1000;
+    }
+    else {
+        *a_time_us = monotonic_us();
+    }
+
+    /* sysex arrives in chunks, the first one starts with F0 and
+       the last one ends with F7 */
+    if ( ev->type == SND_SEQ_EVENT_SYSEX ){
 
-    snd_seq_event_input(m_alsa_seq, &ev);
+        unsigned char *data = (unsigned char *) ev->data.ext.ptr;
+        long size = ev->data.ext.len;
 
-    /* alsa midi parser */
-    snd_midi_event_t *midi_ev;
-    snd_midi_event_new(sizeof(buffer), &midi_ev);
+        if ( size > 0 && data[0] == EVENT_SYSEX )
+            m_sysex_input.clear();
+
+        /* stray or oversized, drop it */
+        if ( size <= 0 ||
+             (m_sysex_input.empty() && data[0] != EVENT_SYSEX) ||
+             m_sysex_input.size() + size > (size_t) c_midibus_sysex_max ){
+
+            m_sysex_input.clear();
+            unlock_input();
+            return false;
+        }
 
-    long bytes = snd_midi_event_decode(midi_ev, buffer, sizeof(buffer), ev);
+        m_sysex_input.insert( m_sysex_input.end(), data, data + size );
+
+        if ( m_sysex_input.back() != EVENT_SYSEX_END ){
+            unlock_input();
+            return false;
+        }
+
+        a_in->set_status( EVENT_SYSEX );
+        a_in->set_sysex( &m_sysex_input[0], m_sysex_input.size() );
+
+        m_sysex_input.clear();
+
+        m_router.route( ev->source.client << 8 | ev->source.port,
+                        EVENT_SYSEX, 0, a_targets );
+
+        unlock_input();
+        return true;
+    }
+
+    long bytes = snd_midi_event_decode(m_midi_decoder, buffer, sizeof(buffer), ev);
 
     if (bytes <= 0) {
-        unlock();
+        unlock_input();
         return false;
     }
 
-    a_in->set_timestamp( ev->time.tick );
     a_in->set_status_midibus( buffer[0] );     // keep channel bit
-    a_in->set_size( bytes );
-
-    /* we will only get EVENT_SYSEX on the first
-       packet of midi data, the rest we have
-       to poll for */
-    //if ( buffer[0] == EVENT_SYSEX ){
-    if (0) {
+    a_in->start_sysex( );
+    a_in->set_data( buffer[1], buffer[2] );
 
-        /* set up for sysex if needed */
-        a_in->start_sysex( );
-        sysex = a_in->append_sysex( buffer, bytes );
+    // some keyboards send on's with vel 0 for off
+    if ( a_in->get_status() == EVENT_NOTE_ON &&
+         a_in->get_note_velocity() == 0x00 ){
+        a_in->set_status( EVENT_NOTE_OFF );
     }
-    else {
-        a_in->set_data( buffer[1], buffer[2] );
 
-        // some keyboards send on's with vel 0 for off
-        if ( a_in->get_status() == EVENT_NOTE_ON &&
-             a_in->get_note_velocity() == 0x00 ){
-            a_in->set_status( EVENT_NOTE_OFF );
-        }
+    m_router.route( ev->source.client << 8 | ev->source.port,
+                    buffer[0], buffer[1], a_targets );
+
+    unlock_input();
+    return true;
+}
+
+void
+mastermidibus::set_sequence_input( sequence *a_seq )
+{
+    lock_input();
+
+    vector < sequence * > armed;
+    m_router.get_sequences( &armed );
 
-        sysex = false;
+    for ( size_t i = 0; i < armed.size(); i++ ){
+        armed[i]->set_recording( false );
+        off_thru_notes( armed[i] );
     }
 
-    /* sysex messages might be more than one message */
-    while (sysex) {
+    m_router.clear();
 
-        snd_seq_event_input(m_alsa_seq, &ev);
+    if ( a_seq != NULL ){
 
-        bytes = snd_midi_event_decode(midi_ev, buffer, sizeof(buffer), ev);
+        midiroute route;
+        midirouter::parse( "", &route );
+        route.m_seq = a_seq;
 
-        if (bytes > 0)
-            sysex = a_in->append_sysex( buffer, bytes );
-        else
-            sysex = false;
+        m_router.add( &route );
+        a_seq->set_recording( true );
     }
 
-    snd_midi_event_free( midi_ev );
+    unlock_input();
+}
 
-    unlock();
-    return true;
+bool
+mastermidibus::add_sequence_input( midiroute *a_route )
+{
+    lock_input();
+
+    bool ret = m_router.add( a_route );
+
+    if ( ret )
+        a_route->m_seq->set_recording( true );
+
+    unlock_input();
+
+    return ret;
 }
 
 void
-mastermidibus::set_sequence_input( sequence *a_seq )
+mastermidibus::remove_sequence_input( sequence *a_seq )
 {
-    lock();
+    lock_input();
 
-	if (m_seq != NULL) m_seq->set_recording(false);
-	if (a_seq != NULL) a_seq->set_recording(true);
+    if ( m_router.has( a_seq )){
+        m_router.remove( a_seq );
+        a_seq->set_recording( false );
+        off_thru_notes( a_seq );
+    }
 
-    m_seq = a_seq;
+    unlock_input();
+}
 
-    unlock();
+bool
+mastermidibus::is_dumping( sequence *a_seq )
+{
+    lock_input();
+    bool ret = m_router.has( a_seq );
+    unlock_input();
+
+    return ret;
 }
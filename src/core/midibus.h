@@ -24,9 +24,13 @@ class midibus;
 #include <alsa/asoundlib.h>
 #include <alsa/seq_midi_event.h>
 
+#include <atomic>
+#include <list>
 #include <string>
+#include <vector>
 
 #include "event.h"
+#include "midirouter.h"
 #include "sequence.h"
 #include "mutex.h"
 #include "globals.h"
@@ -35,6 +39,15 @@ const int c_midibus_output_size = 0x100000;
 const int c_midibus_input_size =  0x100000;
 const int c_midibus_sysex_chunk = 0x100;
 
+/* sysex output pace in bytes per second, 31250 baud at 10 bits a byte */
+const long c_midibus_sysex_rate = 3125;
+
+/* incoming sysex larger than this is dropped */
+const long c_midibus_sysex_max = 0x100000;
+
+/* decode buffer for channel and system common messages */
+const int c_midibus_decode_size = 0x10;
+
 class midibus
 {
 
@@ -63,6 +76,16 @@ class midibus
     /* last tick */
     long m_lasttick;
 
+    /* outgoing sysex being sent chunk by chunk, the buffer is
+       kept between messages */
+    vector < unsigned char > m_sysex_pending;
+    size_t m_sysex_sent;
+
+    /* time the next chunk may be sent, in microseconds */
+    long long m_sysex_next_us;
+
+    /* events played while a sysex is being sent, with their channel */
+    list < pair < event, unsigned char > > m_sysex_deferred;
 
     /* locking */
     smutex m_mutex;
@@ -106,8 +129,21 @@ class midibus
 
     /* puts an event in the queue */
     void play( event *a_e24, unsigned char a_channel );
+
+    /* queues a sysex message, it is sent in chunks paced at the
+       midi rate by the following calls to flush() */
     void sysex( event *a_e24 );
 
+    /* puts the chunks of the pending sysex that are due in the queue */
+    void send_sysex();
+
+    /* time the next chunk is due, false if no sysex is pending */
+    bool get_sysex_due( long long *a_us );
+
+    /* ends the sysex being sent and drops those waiting, then plays
+       the events held back behind them */
+    void abort_sysex();
+
 
     void set_input( bool a_inputing );
     bool get_input( );
@@ -127,8 +163,11 @@ class mastermidibus
 {
  private:
 
-    /* sequencer client handle */
+    /* sequencer client handles, output buses and the queue live on
+       the first one, input buses on the second so that the input
+       thread never waits on the output thread */
     snd_seq_t *m_alsa_seq;
+    snd_seq_t *m_alsa_seq_in;
 
     int m_num_out_buses;
     int m_num_in_buses;
@@ -148,22 +187,57 @@ class mastermidibus
     /* id of queue */
     int m_queue;
 
+    /* monotonic time when the queue's real time was 0, in microseconds */
+    long long m_queue_offset_us;
+
     int m_ppqn;
     double m_bpm;
 
+    /* decoder for incoming events, and the sysex being assembled
+       from them, both reused from one event to the next */
+    snd_midi_event_t *m_midi_decoder;
+    vector < unsigned char > m_sysex_input;
+
     int  m_num_poll_descriptors;
     struct pollfd *m_poll_descriptors;
 
-    /* for dumping midi input to sequence for recording */
-    bool m_dumping_input;
-    sequence *m_seq;
+    /* for dumping midi input to sequences for recording */
+    midirouter m_router;
 
-    /* locking */
+    /* notes echoed by play_thru() and not released yet, with the
+       bus and channel they went to */
+    struct thru_note
+    {
+        sequence *m_seq;
+        unsigned char m_bus;
+        unsigned char m_channel;
+        unsigned char m_note;
+    };
+
+    vector < thru_note > m_thru_notes;
+    smutex m_thru_mutex;
+
+    /* locking, one for each client */
     smutex m_mutex;
+    smutex m_input_mutex;
+
+    /* CLOCK_MONOTONIC timerfd firing when the next sysex chunk of a
+       bus is due, so that a dump goes on while nothing else flushes.
+       The owner of the bus polls it and calls flush() */
+    int m_sysex_timer;
+    long long m_sysex_timer_us;
+
+    void arm_sysex_timer();
+
+    /* times a lock was held by another thread */
+    atomic<long> m_lock_waits;
+    atomic<long> m_input_lock_waits;
 
     /* mutex */
     void lock();
     void unlock();
+    void lock_input();
+    void unlock_input();
 
  public:
 
@@ -174,6 +248,9 @@ class mastermidibus
 
     snd_seq_t* get_alsa_seq( ) { return m_alsa_seq; };
 
+    long get_lock_waits( ) { return m_lock_waits; }
+    long get_input_lock_waits( ) { return m_input_lock_waits; }
+
     int get_num_out_buses();
     int get_num_in_buses();
 
@@ -188,20 +265,42 @@ class mastermidibus
     void print();
     void flush();
 
+    int get_sysex_timer( ) { return m_sysex_timer; }
+
+    /* see midibus::abort_sysex(), for panic and stop */
+    void abort_sysex();
+
     void start();
     void stop();
 
-    int poll_for_midi( );
+    /* descriptors signalling input, a_fds points at the array */
+    int get_poll_descriptors( struct pollfd **a_fds );
     bool is_more_input( );
-    bool get_midi_event( event *a_in );
+    /* a_time_us gets the arrival time of the event, in microseconds
+       of CLOCK_MONOTONIC, a_targets the sequences recording it */
+    bool get_midi_event( event *a_in, long long *a_time_us,
+                         vector < sequence * > *a_targets );
+
+    /* arms a_seq alone for recording everything, NULL disarms all */
     void set_sequence_input( sequence *a_seq );
 
-    bool is_dumping( ) { return m_seq != NULL; }
-    sequence* get_sequence( ) { return m_seq; }
+    /* arms a_route->m_seq along the sequences already armed */
+    bool add_sequence_input( midiroute *a_route );
+    void remove_sequence_input( sequence *a_seq );
+
+    bool is_dumping( sequence *a_seq );
     void sysex( event *a_event );
 
     void play( unsigned char a_bus, event *a_e24, unsigned char a_channel );
 
+    /* echoes a_e on the bus and channel of a_seq if it is armed with
+       thru, false otherwise. Note offs are only sent for the notes
+       it echoed, the caller flushes */
+    bool play_thru( sequence *a_seq, event *a_e );
+
+    /* note offs for the notes echoed for a_seq, NULL for all */
+    void off_thru_notes( sequence *a_seq );
+
     void set_input( unsigned char a_bus, bool a_inputing );
     bool get_input( unsigned char a_bus );
 
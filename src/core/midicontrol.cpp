@@ -0,0 +1,192 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+#include "midicontrol.h"
+
+static const char *c_midicontrol_names[] = {
+    "none", "toggle", "queue", "scene", "screenset", "bpm"
+};
+
+midicontrol::midicontrol()
+{
+    m_hits.resize( c_midicontrol_queue );
+
+    m_head = 0;
+    m_tail = 0;
+    m_learn = 0;
+
+    clear();
+    reset_feedback();
+}
+
+void
+midicontrol::set( int a_channel, int a_entry, control_action a_action, int a_value )
+{
+    if ( a_channel < 0 || a_channel > 15 ||
+         a_entry < 0 || a_entry >= c_midicontrol_entries )
+        return;
+
+    m_table[a_channel][a_entry].store( a_action << 16 | (a_value & 0xFFFF),
+                                       memory_order_relaxed );
+}
+
+bool
+midicontrol::get( int a_channel, int a_entry, control_action *a_action, int *a_value )
+{
+    uint32_t entry = m_table[a_channel][a_entry].load( memory_order_relaxed );
+
+    *a_action = (control_action) (entry >> 16);
+    *a_value = entry & 0xFFFF;
+
+    return entry != 0;
+}
+
+void
+midicontrol::clear()
+{
+    for ( int c = 0; c < 16; c++ )
+        for ( int i = 0; i < c_midicontrol_entries; i++ )
+            m_table[c][i].store( 0, memory_order_relaxed );
+}
+
+void
+midicontrol::learn( control_action a_action, int a_value )
+{
+    m_learn = a_action << 16 | (a_value & 0xFFFF);
+}
+
+bool
+midicontrol::dispatch( event *a_e )
+{
+    unsigned char status = a_e->get_status();
+    unsigned char d0, d1;
+    int entry;
+    bool press;
+
+    a_e->get_data( &d0, &d1 );
+
+    switch ( status & 0xF0 ){
+
+        case EVENT_NOTE_ON:
+            entry = d0;
+            press = d1 > 0;
+            d1 = 0;
+            break;
+
+        case EVENT_NOTE_OFF:
+            entry = d0;
+            press = false;
+            break;
+
+        case EVENT_CONTROL_CHANGE:
+            entry = 128 + d0;
+            press = d1 > 0;
+            break;
+
+        default:
+            return false;
+    }
+
+    int channel = status & 0x0F;
+
+    if ( press && m_learn.load( memory_order_relaxed ) != 0 ){
+
+        uint32_t learnt = m_learn.exchange( 0 );
+
+        if ( learnt != 0 ){
+            m_table[channel][entry].store( learnt, memory_order_relaxed );
+            return true;
+        }
+    }
+
+    uint32_t mapping = m_table[channel][entry].load( memory_order_relaxed );
+
+    if ( mapping == 0 )
+        return false;
+
+    /* releases are swallowed, except by tempo faders going down to 0 */
+    if ( !press && !((mapping >> 16) == CONTROL_BPM && entry >= 128) )
+        return true;
+
+    size_t head = m_head.load( memory_order_relaxed );
+
+    if ( head - m_tail.load( memory_order_acquire ) >= c_midicontrol_queue )
+        return true;
+
+    m_hits[head & (c_midicontrol_queue - 1)] = (mapping >> 16) << 24 |
+        (mapping & 0xFFFF) << 8 | (entry >= 128 ? d1 : 0);
+    m_head.store( head + 1, memory_order_release );
+
+    return true;
+}
+
+bool
+midicontrol::pop( control_action *a_action, int *a_value, int *a_data )
+{
+    size_t tail = m_tail.load( memory_order_relaxed );
+
+    if ( tail == m_head.load( memory_order_acquire ))
+        return false;
+
+    uint32_t hit = m_hits[tail & (c_midicontrol_queue - 1)];
+    m_tail.store( tail + 1, memory_order_release );
+
+    *a_action = (control_action) (hit >> 24);
+    *a_value = (hit >> 8) & 0xFFFF;
+    *a_data = hit & 0xFF;
+
+    return true;
+}
+
+bool
+midicontrol::feedback_changed( int a_channel, int a_entry, int a_state )
+{
+    if ( m_feedback[a_channel][a_entry] == a_state )
+        return false;
+
+    m_feedback[a_channel][a_entry] = a_state;
+
+    return true;
+}
+
+void
+midicontrol::reset_feedback()
+{
+    for ( int c = 0; c < 16; c++ )
+        for ( int i = 0; i < c_midicontrol_entries; i++ )
+            m_feedback[c][i] = -1;
+}
+
+bool
+midicontrol::parse_action( const string &a_name, control_action *a_action )
+{
+    for ( int i = CONTROL_TOGGLE; i <= CONTROL_BPM; i++ ){
+        if ( a_name == c_midicontrol_names[i] ){
+            *a_action = (control_action) i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *
+midicontrol::action_name( control_action a_action )
+{
+    return c_midicontrol_names[a_action];
+}
@@ -0,0 +1,108 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+#ifndef SEQ192_MIDICONTROL
+#define SEQ192_MIDICONTROL
+
+#include <atomic>
+#include <vector>
+
+#include "event.h"
+#include "globals.h"
+
+enum control_action
+{
+    CONTROL_NONE = 0,
+    CONTROL_TOGGLE,
+    CONTROL_QUEUE,
+    CONTROL_SCENE,
+    CONTROL_SCREENSET,
+    CONTROL_BPM
+};
+
+/* entries per channel: notes 0-127, then controllers 0-127 */
+const int c_midicontrol_entries = 256;
+
+/* hits the queue can hold, a power of two */
+const size_t c_midicontrol_queue = 0x100;
+
+/* period of the feedback, one GUI frame */
+const long c_midicontrol_frame_us = 40000;
+
+/* feedback sent for the state of a sequence */
+const int c_midicontrol_led_empty = 0;
+const int c_midicontrol_led_stopped = 1;
+const int c_midicontrol_led_queued = 64;
+const int c_midicontrol_led_playing = 127;
+
+/* maps the notes and controllers of a control surface to sequencer
+   actions. The input thread looks events up in a fixed table and
+   queues the hits, the thread owning the sequences pops and applies
+   them: nothing on the input side locks or allocates. The value of
+   an entry is the slot (col * rows + row) for toggle and queue, the
+   row for scene, the screen set for screenset and the base tempo
+   for bpm, which adds the controller value to it. */
+class midicontrol
+{
+
+ private:
+
+    /* channel, entry -> action << 16 | value, 0 if unmapped */
+    atomic < uint32_t > m_table[16][c_midicontrol_entries];
+
+    /* mapping given to the next note or controller, 0 if none */
+    atomic < uint32_t > m_learn;
+
+    /* hits, action << 24 | value << 8 | data */
+    vector < uint32_t > m_hits;
+    atomic < size_t > m_head;
+    atomic < size_t > m_tail;
+
+    /* last feedback sent, -1 if none. Only used by the thread
+       sending the feedback */
+    int m_feedback[16][c_midicontrol_entries];
+
+ public:
+
+    midicontrol();
+
+    void set( int a_channel, int a_entry, control_action a_action, int a_value );
+    bool get( int a_channel, int a_entry, control_action *a_action, int *a_value );
+    void clear();
+
+    /* the next note or controller received gets this mapping */
+    void learn( control_action a_action, int a_value );
+
+    /* input side: queues the hit if a_e (channel bits kept) is
+       mapped, true if the event was taken by a control */
+    bool dispatch( event *a_e );
+
+    /* consumer side, false if no hit is waiting. a_data is the
+       controller value, 0 for notes */
+    bool pop( control_action *a_action, int *a_value, int *a_data );
+
+    /* true if a_state differs from the last one sent for the entry,
+       which then becomes a_state */
+    bool feedback_changed( int a_channel, int a_entry, int a_state );
+    void reset_feedback();
+
+    static bool parse_action( const string &a_name, control_action *a_action );
+    static const char *action_name( control_action a_action );
+};
+
+#endif
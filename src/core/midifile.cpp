@@ -16,11 +16,20 @@
 
 #include "midifile.h"
 #include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 midifile::midifile(const string& a_name)
 {
     m_name = a_name;
     m_pos = 0;
+    m_d = NULL;
+    m_size = 0;
+    m_truncated = false;
 }
 
 midifile::~midifile ()
@@ -28,11 +37,35 @@ midifile::~midifile ()
 }
 
 
+bool
+midifile::available (size_t a_n)
+{
+    if (a_n > m_size - m_pos)
+    {
+        m_truncated = true;
+        return false;
+    }
+
+    return true;
+}
+
+unsigned char
+midifile::read_byte ()
+{
+    if (!available (1))
+        return 0;
+
+    return m_d[m_pos++];
+}
+
 unsigned long
 midifile::read_long ()
 {
     unsigned long ret = 0;
 
+    if (!available (4))
+        return 0;
+
     ret += (m_d[m_pos++] << 24);
     ret += (m_d[m_pos++] << 16);
     ret += (m_d[m_pos++] << 8);
@@ -46,6 +79,9 @@ midifile::read_short ()
 {
     unsigned short ret = 0;
 
+    if (!available (2))
+        return 0;
+
     ret += (m_d[m_pos++] << 8);
     ret += (m_d[m_pos++]);
 
@@ -59,8 +95,9 @@ midifile::read_var ()
     unsigned long ret = 0;
     unsigned char c;
 
-    /* while bit #7 is set */
-    while (((c = m_d[m_pos++]) & 0x80) != 0x00)
+    /* while bit #7 is set, a variable length quantity is 4 bytes
+       at most */
+    for (int i = 0; ((c = read_byte ()) & 0x80) != 0x00 && i < 3; i++)
     {
         /* shift ret 7 bits */
         ret <<= 7;
@@ -75,48 +112,68 @@ midifile::read_var ()
     return ret;
 }
 
+void
+midifile::skip (size_t a_n)
+{
+    if (!available (a_n))
+        m_pos = m_size;
+    else
+        m_pos += a_n;
+}
+
 
 bool midifile::parse (perform * a_perf, int a_screen_set)
 {
-    /* open binary file */
-    ifstream file(m_name.c_str(), ios::in | ios::binary | ios::ate);
+    /* map the file */
+    int fd = open (m_name.c_str (), O_RDONLY);
 
-    if (!file.is_open ()) {
+    if (fd < 0) {
         fprintf(stderr, "Error opening MIDI file\n");
         return false;
     }
 
-    int file_size = file.tellg ();
+    struct stat st;
+    if (fstat (fd, &st) < 0 || st.st_size < 14) {
+        fprintf(stderr, "Invalid MIDI file: too short\n");
+        close (fd);
+        return false;
+    }
 
-    /* run to start */
-    file.seekg (0, ios::beg);
+    m_size = st.st_size;
+    m_d = (unsigned char *) mmap (NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
 
-    /* alloc data */
-    m_d = (unsigned char *) new char[file_size];
-    if (m_d == NULL) {
-        fprintf(stderr, "Memory allocation failed\n");
+    if (m_d == MAP_FAILED) {
+        fprintf(stderr, "Error mapping MIDI file\n");
+        m_d = NULL;
         return false;
     }
-    file.read ((char *) m_d, file_size);
-    file.close ();
 
-    /* set position to 0 */
+    /* read once, front to back */
+    madvise (m_d, m_size, MADV_SEQUENTIAL);
+
     m_pos = 0;
+    m_truncated = false;
 
-    /* chunk info */
-    unsigned long ID;
-    unsigned long TrackLength;
+    bool ret = parse_data (a_perf, a_screen_set);
 
+    munmap (m_d, m_size);
+    m_d = NULL;
+
+    return ret;
+}
+
+
+/* decodes the track held by the whole mapping, independent from the
+   other tracks: the sequence is not attached to the bus yet, the bus
+   and channel are applied when the track is committed */
+bool midifile::parse_track (unsigned short a_ppqn, midi_track *a_track)
+{
     /* time */
     unsigned long Delta;
     unsigned long RunningTime;
     unsigned long CurrentTime;
 
-    unsigned short Format;			/* 0,1,2 */
-    unsigned short NumTracks;
-    unsigned short ppqn;
-    unsigned short perf;
-
     /* track name from file */
     char TrackName[256];
 
@@ -127,285 +184,404 @@ bool midifile::parse (perform * a_perf, int a_screen_set)
     sequence * seq;
     event e;
 
-    /* read in header */
-    ID = read_long ();
-    TrackLength = read_long ();
-    Format = read_short ();
-    NumTracks = read_short ();
-    ppqn = read_short ();
+    /* events of the track, handed to the sequence at its end */
+    list<event> events;
 
-    //printf( "[%8lX] len[%ld] fmt[%d] num[%d] ppqn[%d]\n",
-    //      ID, TrackLength, Format, NumTracks, ppqn );
+    /* done for each track */
+    bool done = false;
 
-    /* magic number 'MThd' */
-    if (ID != 0x4D546864) {
-        fprintf(stderr, "Invalid MIDI header detected: %8lX\n", ID);
-        delete[]m_d;
-        return false;
-    }
+    /* events */
+    unsigned char status = 0, type, data[2], laststatus;
+    long len;
+    size_t meta_end;
+    unsigned long proprietary = 0;
 
-    /* we are only supporting format 1 for now */
-    if (Format != 1) {
-        fprintf(stderr, "Unsupported MIDI format detected: %d\n", Format);
-        delete[]m_d;
-        return false;
-    }
+    a_track->m_perf = 0;
+    a_track->m_bus = -1;
+    a_track->m_channel = -1;
 
-    /* We should be good to load now   */
-    /* for each Track in the midi file */
-    for (int curTrack = 0; curTrack < NumTracks; curTrack++)
-    {
-        /* done for each track */
-        bool done = false;
-        perf = 0;
+    /* we know we have a good track, so we can create
+       a new sequence to dump it to */
+    seq = new sequence ();
+    a_track->m_seq = seq;
 
-        /* events */
-        unsigned char status = 0, type, data[2], laststatus;
-        long len;
-        unsigned long proprietary = 0;
+    /* reset time */
+    RunningTime = 0;
 
-        /* Get ID + Length */
-        ID = read_long ();
-        TrackLength = read_long ();
-        //printf( "[%8lX] len[%8lX]\n", ID,  TrackLength );
+    /* this gets each event in the Trk */
+    while (!done && !m_truncated)
+    {
+        /* get time delta */
+        Delta = read_var ();
 
+        if (!available (1))
+            break;
 
-        /* magic number 'MTrk' */
-        if (ID == 0x4D54726B)
+        /* get status */
+        laststatus = status;
+        status = m_d[m_pos];
+
+        /* is it a status bit ? */
+        if ((status & 0x80) == 0x00)
         {
-            /* we know we have a good track, so we can create
-               a new sequence to dump it to */
-            seq = new sequence ();
-            if (seq == NULL) {
-                fprintf(stderr, "Memory allocation failed\n");
-                delete[]m_d;
-                return false;
-            }
-            seq->set_master_midi_bus (&a_perf->m_master_bus);
+            /* no, its a running status */
+            status = laststatus;
+        }
+        else
+        {
+            /* its a status, increment */
+            m_pos++;
+        }
 
-            /* reset time */
-            RunningTime = 0;
+        /* set the members in event */
+        e.set_status (status);
 
-            /* this gets each event in the Trk */
-            while (!done)
-            {
-                /* get time delta */
-                Delta = read_var ();
+        RunningTime += Delta;
+        /* current time is ppqn according to the file,
+           we have to adjust it to our own ppqn.
+           PPQN / ppqn gives us the ratio */
+        CurrentTime = (RunningTime * c_ppqn) / a_ppqn;
 
-                /* get status */
-                laststatus = status;
-                status = m_d[m_pos];
+        //printf( "D[%6ld] [%6ld] %02X\n", Delta, CurrentTime, status);
+        e.set_timestamp (CurrentTime);
 
-                /* is it a status bit ? */
-                if ((status & 0x80) == 0x00)
-                {
-                    /* no, its a running status */
-                    status = laststatus;
-                }
-                else
+        /* switch on the channelless status */
+        switch (status & 0xF0)
+        {
+            /* case for those with 2 data bytes */
+            case EVENT_NOTE_OFF:
+            case EVENT_NOTE_ON:
+            case EVENT_AFTERTOUCH:
+            case EVENT_CONTROL_CHANGE:
+            case EVENT_PITCH_WHEEL:
+
+                data[0] = read_byte ();
+                data[1] = read_byte ();
+
+                // some files have vel=0 as note off
+                if ((status & 0xF0) == EVENT_NOTE_ON && data[1] == 0)
                 {
-                    /* its a status, increment */
-                    m_pos++;
+                    e.set_status (EVENT_NOTE_OFF);
                 }
 
-                /* set the members in event */
-                e.set_status (status);
+                //printf( "%02X %02X\n", data[0], data[1] );
 
-                RunningTime += Delta;
-                /* current time is ppqn according to the file,
-                   we have to adjust it to our own ppqn.
-                   PPQN / ppqn gives us the ratio */
-                CurrentTime = (RunningTime * c_ppqn) / ppqn;
+                /* set data and add */
+                e.set_data (data[0], data[1]);
+                events.push_back (e);
 
-                //printf( "D[%6ld] [%6ld] %02X\n", Delta, CurrentTime, status);
-                e.set_timestamp (CurrentTime);
+                /* midi channel */
+                a_track->m_channel = status & 0x0F;
+                break;
 
-                /* switch on the channelless status */
-                switch (status & 0xF0)
-                {
-                    /* case for those with 2 data bytes */
-                    case EVENT_NOTE_OFF:
-                    case EVENT_NOTE_ON:
-                    case EVENT_AFTERTOUCH:
-                    case EVENT_CONTROL_CHANGE:
-                    case EVENT_PITCH_WHEEL:
+                /* one data item */
+            case EVENT_PROGRAM_CHANGE:
+            case EVENT_CHANNEL_PRESSURE:
+
+                data[0] = read_byte ();
+                //printf( "%02X\n", data[0] );
 
-                        data[0] = m_d[m_pos++];
-                        data[1] = m_d[m_pos++];
+                /* set data and add */
+                e.set_data (data[0]);
+                events.push_back (e);
 
-                   //     fprintf(stderr,"data[0] : %d | data[1] %d\n",data[0],data[1]);
+                /* midi channel */
+                a_track->m_channel = status & 0x0F;
+                break;
 
-                        // some files have vel=0 as note off
-                        if ((status & 0xF0) == EVENT_NOTE_ON && data[1] == 0)
-                        {
-                            e.set_status (EVENT_NOTE_OFF);
-                        }
+                /* meta midi events ---  this should be FF !!!!!  */
+            case 0xF0:
 
-                        //printf( "%02X %02X\n", data[0], data[1] );
+                if (status == 0xFF)
+                {
+                    /* get meta type */
+                    type = read_byte ();
+                    len = read_var ();
 
-                        /* set data and add */
-                        e.set_data (data[0], data[1]);
-                        seq->add_event (&e);
+                    //printf( "%02X %08X ", type, (int) len );
 
-                        /* set midi channel */
-                        seq->set_midi_channel (status & 0x0F);
-//                        fprintf(stderr,"Midi Channel : %d | 0x0F %d\n",status & 0x0F, 0x0F);
+                    if (!available (len))
                         break;
 
-                        /* one data item */
-                    case EVENT_PROGRAM_CHANGE:
-                    case EVENT_CHANNEL_PRESSURE:
+                    /* whatever is read below, the next event
+                       starts here */
+                    meta_end = m_pos + len;
 
-                        data[0] = m_d[m_pos++];
-                        //printf( "%02X\n", data[0] );
+                    switch (type)
+                    {
+                        /* proprietary */
+                        case 0x7f:
 
-                        /* set data and add */
-                        e.set_data (data[0]);
-                        seq->add_event (&e);
+                            /* FF 7F len data  */
+                            if (len > 4)
+                            {
+                                proprietary = read_long ();
+                                len -= 4;
+                            }
 
-                        /* set midi channel */
-                        seq->set_midi_channel (status & 0x0F);
-                        break;
+                            if (proprietary == c_midibus && len >= 1)
+                            {
+                                a_track->m_bus = read_byte ();
+                            }
 
-                        /* meta midi events ---  this should be FF !!!!!  */
-                    case 0xF0:
+                            else if (proprietary == c_midich && len >= 1)
+                            {
+                                a_track->m_channel = read_byte ();
+                            }
 
-                        if (status == 0xFF)
-                        {
-                            /* get meta type */
-                            type = m_d[m_pos++];
-                            len = read_var ();
+                            else if (proprietary == c_timesig && len >= 2)
+                            {
+                                seq->set_bpm (read_byte ());
+                                seq->set_bw (read_byte ());
+                            }
 
-                            //printf( "%02X %08X ", type, (int) len );
+                            else if (proprietary == c_resume && len >= 1)
+                            {
+                                seq->set_resume (read_byte ());
+                            }
 
-                            switch (type)
+                            else if (proprietary == c_alt_cc && len >= 1)
                             {
-                                /* proprietary */
-                                case 0x7f:
-
-                                    /* FF 7F len data  */
-                                    if (len > 4)
-                                    {
-                                        proprietary = read_long ();
-                                        len -= 4;
-                                    }
-
-                                    if (proprietary == c_midibus)
-                                    {
-                                        seq->set_midi_bus (m_d[m_pos++]);
-                                        len--;
-                                    }
-
-                                    else if (proprietary == c_midich)
-                                    {
-                                        seq->set_midi_channel (m_d[m_pos++]);
-                                        len--;
-                                    }
-
-                                    else if (proprietary == c_timesig)
-                                    {
-                                        seq->set_bpm (m_d[m_pos++]);
-                                        seq->set_bw (m_d[m_pos++]);
-                                        len -= 2;
-                                    }
-
-                                    else if (proprietary == c_resume)
-                                    {
-                                        seq->set_resume (m_d[m_pos++]);
-                                        len--;
-                                    }
-
-                                    else if (proprietary == c_alt_cc)
-                                    {
-                                        seq->set_alt_cc (m_d[m_pos++] - 1);
-                                        len--;
-                                    }
-
-                                    /* eat the rest */
-                                    m_pos += len;
-                                    break;
-
-                                    /* Trk Done */
-                                case 0x2f:
-
-                                    // If delta is 0, then another event happened at the same time
-                                    // as the track end.  the sequence class will discard the last
-                                    // note.  This is a fix for that.   Native Seq24 file will always
-                                    // have a Delta >= 1
-                                    if ( Delta == 0 ){
-                                        CurrentTime += 1;
-                                    }
-
-                                    seq->set_length (CurrentTime);
-                                    seq->zero_markers ();
-                                    done = true;
-                                    break;
-
-                                    /* Track name */
-                                case 0x03:
-                                    for (i = 0; i < len; i++)
-                                    {
-                                        TrackName[i] = m_d[m_pos++];
-                                    }
-
-                                    TrackName[i] = '\0';
-
-                                    //printf("[%s]\n", TrackName );
-                                    seq->set_name (TrackName);
-                                    break;
-
-                                    /* sequence number */
-                                case 0x00:
-                                    if (len == 0x00)
-                                        perf = 0;
-                                    else
-                                        perf = read_short ();
-
-                                    //printf ( "perf %d\n", perf );
-                                    break;
-
-                                default:
-                                    // int c;
-                                    // for (i = 0; i < len; i++)
-                                    // {
-                                    //     c = m_d[m_pos++];
-                                        //printf( "%02X ", c  );
-                                    // }
-                                    //printf("\n");
-                                    break;
+                                seq->set_alt_cc (read_byte () - 1);
                             }
-                        }
-                        else if(status == 0xF0)
-                        {
-                            /* sysex */
-                            len = read_var ();
-
-                            /* skip it */
-                            m_pos += len;
-
-                            fprintf(stderr, "Warning, no support for SYSEX messages, discarding.\n");
-                        }
-                        else
-                        {
-                            fprintf(stderr, "Unexpected system event : 0x%.2X", status);
-                            delete[]m_d;
-                            return false;
-                        }
 
-                        break;
+                            break;
+
+                            /* Trk Done */
+                        case 0x2f:
+
+                            // If delta is 0, then another event happened at the same time
+                            // as the track end.  the sequence class will discard the last
+                            // note.  This is a fix for that.   Native Seq24 file will always
+                            // have a Delta >= 1
+                            if ( Delta == 0 ){
+                                CurrentTime += 1;
+                            }
+
+                            /* one sort for the whole track, then
+                               the length links the notes */
+                            seq->add_events (&events);
+                            seq->set_length (CurrentTime);
+                            seq->zero_markers ();
+                            done = true;
+                            break;
+
+                            /* Track name */
+                        case 0x03:
+                            for (i = 0; i < len && i < 255; i++)
+                            {
+                                TrackName[i] = m_d[m_pos++];
+                            }
+
+                            TrackName[i] = '\0';
+
+                            //printf("[%s]\n", TrackName );
+                            seq->set_name (TrackName);
+                            break;
+
+                            /* sequence number */
+                        case 0x00:
+                            if (len == 0x00)
+                                a_track->m_perf = 0;
+                            else
+                                a_track->m_perf = read_short ();
+
+                            //printf ( "perf %d\n", perf );
+                            break;
+
+                        default:
+                            break;
+                    }
+
+                    m_pos = meta_end;
+                }
+                else if(status == EVENT_SYSEX)
+                {
+                    /* sysex, the length covers the data after F0 */
+                    len = read_var ();
 
-                    default:
-                        fprintf(stderr, "Unsupported MIDI event: %hhu\n", status);
-                        delete[]m_d;
-                        return false;
+                    if (!available (len))
                         break;
+
+                    e.start_sysex ();
+                    e.append_sysex (&status, 1);
+                    e.append_sysex (&m_d[m_pos], len);
+                    m_pos += len;
+
+                    events.push_back (e);
+                    e.start_sysex ();
+                }
+                else if(status == EVENT_SYSEX_END)
+                {
+                    /* sysex continuation or escaped data */
+                    len = read_var ();
+
+                    /* skip it */
+                    skip (len);
+
+                    fprintf(stderr, "Warning, no support for split SYSEX messages, discarding.\n");
                 }
+                else
+                {
+                    fprintf(stderr, "Unexpected system event : 0x%.2X", status);
+                    return false;
+                }
+
+                break;
+
+            default:
+                fprintf(stderr, "Unsupported MIDI event: %hhu\n", status);
+                return false;
+                break;
+        }
+
+    }			/* while ( !done loading Trk chunk */
+
+    if (!done)
+    {
+        fprintf(stderr, "Truncated MIDI file: track %d has no end\n", a_track->m_number);
+        return false;
+    }
+
+    return true;
+}
 
-            }			/* while ( !done loading Trk chunk */
 
-            /* the sequence has been filled, add it  */
-            //printf ( "add_sequence( %d )\n", perf + (a_screen_set * c_seqs_in_set));
-            a_perf->add_sequence (seq, perf + (a_screen_set * c_seqs_in_set));
+/* worker of the decoding pool, takes the next undecoded track until
+   none is left */
+void *
+midifile::decode_thread (void *a_pool)
+{
+    decode_pool *pool = (decode_pool *) a_pool;
+
+    midifile reader (pool->m_file->m_name);
+
+    size_t n;
+    while ((n = pool->m_next++) < pool->m_tracks->size ())
+    {
+        midi_track *track = &(*pool->m_tracks)[n];
+
+        reader.m_d = pool->m_file->m_d + track->m_start;
+        reader.m_size = track->m_length;
+        reader.m_pos = 0;
+        reader.m_truncated = false;
+
+        track->m_ok = reader.parse_track (pool->m_ppqn, track);
+    }
+
+    return NULL;
+}
+
+
+/* hands a decoded track to a_perf, as sequence a_num or the next
+   free one */
+void midifile::commit_track (perform * a_perf, midi_track *a_track, int a_num)
+{
+    sequence *seq = a_track->m_seq;
+
+    seq->set_master_midi_bus (&a_perf->m_master_bus);
+
+    if (a_track->m_bus >= 0)
+        seq->set_midi_bus (a_track->m_bus);
+
+    if (a_track->m_channel >= 0)
+        seq->set_midi_channel (a_track->m_channel);
+
+    /* the sequence has been filled, add it  */
+    //printf ( "add_sequence( %d )\n", a_num);
+    a_perf->add_sequence (seq, a_num);
+}
+
+
+bool midifile::load_track (perform * a_perf, unsigned char *a_data, size_t a_size, int a_num)
+{
+    midi_track track;
+    track.m_number = a_num;
+    track.m_start = 0;
+    track.m_length = a_size;
+
+    m_d = a_data;
+    m_size = a_size;
+    m_pos = 0;
+    m_truncated = false;
+
+    bool ok = parse_track (c_ppqn, &track);
+    m_d = NULL;
+
+    if (!ok) {
+        delete track.m_seq;
+        return false;
+    }
+
+    if (a_perf->is_active (a_num))
+        a_perf->delete_sequence (a_num);
+
+    commit_track (a_perf, &track, a_num);
+
+    return true;
+}
+
+
+bool midifile::parse_data (perform * a_perf, int a_screen_set)
+{
+    /* chunk info */
+    unsigned long ID;
+    unsigned long TrackLength;
+
+    unsigned short Format;			/* 0,1,2 */
+    unsigned short NumTracks;
+    unsigned short ppqn;
+
+    /* read in header */
+    ID = read_long ();
+    TrackLength = read_long ();
+    Format = read_short ();
+    NumTracks = read_short ();
+    ppqn = read_short ();
+
+    //printf( "[%8lX] len[%ld] fmt[%d] num[%d] ppqn[%d]\n",
+    //      ID, TrackLength, Format, NumTracks, ppqn );
+
+    /* magic number 'MThd' */
+    if (ID != 0x4D546864) {
+        fprintf(stderr, "Invalid MIDI header detected: %8lX\n", ID);
+        return false;
+    }
+
+    /* we are only supporting format 1 for now */
+    if (Format != 1) {
+        fprintf(stderr, "Unsupported MIDI format detected: %d\n", Format);
+        return false;
+    }
+
+    if (ppqn == 0) {
+        fprintf(stderr, "Invalid MIDI division: 0\n");
+        return false;
+    }
+
+    /* locate the tracks: each one is decoded from its own byte range */
+    vector<midi_track> tracks;
+
+    for (int curTrack = 0; curTrack < NumTracks; curTrack++)
+    {
+        /* Get ID + Length */
+        ID = read_long ();
+        TrackLength = read_long ();
+        //printf( "[%8lX] len[%8lX]\n", ID,  TrackLength );
+
+        if (m_truncated || !available (TrackLength))
+            break;
+
+        /* magic number 'MTrk' */
+        if (ID == 0x4D54726B)
+        {
+            midi_track track;
+            track.m_number = curTrack;
+            track.m_start = m_pos;
+            track.m_length = TrackLength;
+            track.m_seq = NULL;
+            track.m_ok = false;
+            tracks.push_back (track);
         }
 
         /* dont know what kind of chunk */
@@ -414,13 +590,64 @@ bool midifile::parse (perform * a_perf, int a_screen_set)
             /* its not a MTrk, we dont know how to deal with it,
                so we just eat it */
             fprintf(stderr, "Unsupported MIDI header detected: %8lX\n", ID);
-            m_pos += TrackLength;
-            done = true;
         }
 
-    }				/* for(eachtrack) */
+        m_pos += TrackLength;
+    }
+
+    /* decode them on a pool of threads, this one included */
+    decode_pool pool;
+    pool.m_file = this;
+    pool.m_tracks = &tracks;
+    pool.m_ppqn = ppqn;
+    pool.m_next = 0;
+
+    long cores = sysconf (_SC_NPROCESSORS_ONLN);
+    size_t threads = cores < 1 ? 1 : cores;
+    if (threads > c_midifile_threads) threads = c_midifile_threads;
+    if (threads > tracks.size ()) threads = tracks.size ();
+
+    vector<pthread_t> workers;
+    for (size_t t = 1; t < threads; t++)
+    {
+        pthread_t worker;
+        if (pthread_create (&worker, NULL, decode_thread, &pool) == 0)
+            workers.push_back (worker);
+    }
+
+    decode_thread (&pool);
+
+    for (size_t t = 0; t < workers.size (); t++)
+        pthread_join (workers[t], NULL);
+
+    /* add them in file order, up to the first bad one as the serial
+       parse did */
+    bool ok = true;
+
+    for (size_t t = 0; t < tracks.size (); t++)
+    {
+        sequence *seq = tracks[t].m_seq;
+
+        if (!ok || !tracks[t].m_ok)
+        {
+            ok = false;
+            delete seq;
+            continue;
+        }
+
+        commit_track (a_perf, &tracks[t], tracks[t].m_perf + (a_screen_set * c_seqs_in_set));
+    }
+
+    if (!ok)
+        return false;
+
+    if (m_truncated)
+    {
+        fprintf(stderr, "Truncated MIDI file: %d tracks expected\n", NumTracks);
+        return false;
+    }
 
-    if ((file_size - m_pos) > (int) sizeof (unsigned long))
+    if ((m_size - m_pos) > sizeof (unsigned long))
     {
         /* Get ID + Length */
         ID = read_long ();
@@ -428,24 +655,25 @@ bool midifile::parse (perform * a_perf, int a_screen_set)
         {
             unsigned int screen_sets = read_short ();
 
-            for (unsigned int x = 0; x < screen_sets; x++)
+            for (unsigned int x = 0; x < screen_sets && !m_truncated; x++)
             {
                 /* get the length of the string */
                 unsigned int len = read_short ();
-                char * notes = new char[len + 1];
 
-                for (unsigned int i = 0; i < len; i++)
-                    notes[i] = m_d[m_pos++];
+                if (!available (len))
+                    break;
+
+                string notess ((char *) &m_d[m_pos], len);
+                m_pos += len;
 
-                notes[len] = '\0';
-                string notess (notes);
+                /* up to the first nul, as before */
+                notess = notess.c_str ();
                 a_perf->set_screen_set_notepad (x + a_screen_set, &notess);
-                delete[]notes;
             }
         }
     }
 
-    if ((file_size - m_pos) > (int) sizeof (unsigned int))
+    if ((m_size - m_pos) > sizeof (unsigned int))
     {
         /* Get ID + Length */
         ID = read_long ();
@@ -463,7 +691,6 @@ bool midifile::parse (perform * a_perf, int a_screen_set)
 
     // *** ADD NEW TAGS AT END **************/
 
-    delete[]m_d;
     return true;
     //printf ( "done\n");
 }
@@ -472,35 +699,47 @@ bool midifile::parse (perform * a_perf, int a_screen_set)
 void
 midifile::write_long (unsigned long a_x)
 {
-    m_l.push_front ((a_x & 0xFF000000) >> 24);
-    m_l.push_front ((a_x & 0x00FF0000) >> 16);
-    m_l.push_front ((a_x & 0x0000FF00) >> 8);
-    m_l.push_front ((a_x & 0x000000FF));
+    m_buffer.push_back ((a_x & 0xFF000000) >> 24);
+    m_buffer.push_back ((a_x & 0x00FF0000) >> 16);
+    m_buffer.push_back ((a_x & 0x0000FF00) >> 8);
+    m_buffer.push_back ((a_x & 0x000000FF));
 }
 
 
 void
 midifile::write_short (unsigned short a_x)
 {
-    m_l.push_front ((a_x & 0xFF00) >> 8);
-    m_l.push_front ((a_x & 0x00FF));
+    m_buffer.push_back ((a_x & 0xFF00) >> 8);
+    m_buffer.push_back ((a_x & 0x00FF));
+}
+
+
+/* overwrites the long written at a_pos, for lengths known afterwards */
+void
+midifile::patch_long (size_t a_pos, unsigned long a_x)
+{
+    m_buffer[a_pos] = (a_x & 0xFF000000) >> 24;
+    m_buffer[a_pos + 1] = (a_x & 0x00FF0000) >> 16;
+    m_buffer[a_pos + 2] = (a_x & 0x0000FF00) >> 8;
+    m_buffer[a_pos + 3] = (a_x & 0x000000FF);
 }
 
 bool midifile::write (perform * a_perf, int a_screen_set, int a_sequence)
 {
-    /* open binary file */
-    ofstream file (m_name.c_str (), ios::out | ios::binary | ios::trunc);
+    fill (a_perf, a_screen_set, a_sequence);
 
-    if (!file.is_open ())
-        return false;
+    return write_buffer ();
+}
 
+void midifile::fill (perform * a_perf, int a_screen_set, int a_sequence)
+{
     /* used in small loops */
     int i;
 
     /* sequence pointer */
     sequence * seq;
-    event e;
-    list<char> l;
+
+    m_buffer.clear ();
 
     /* get number of tracks */
     int numtracks = 0;
@@ -551,19 +790,15 @@ bool midifile::write (perform * a_perf, int a_screen_set, int a_sequence)
             //printf ("track[%d]\n", curTrack );
 
             seq = a_perf->get_sequence (curTrack);
-            seq->fill_list (&l, curTrack - minTrack);
 
-            /* magic number 'MTrk' */
+            /* magic number 'MTrk', length filled in below */
             write_long (0x4D54726B);
-            write_long (l.size ());
+            size_t length_pos = m_buffer.size ();
+            write_long (0);
 
-            //printf("MTrk len[%d]\n", l.size());
+            seq->fill_buffer (&m_buffer, curTrack - minTrack);
 
-            while (l.size () > 0)
-            {
-                m_l.push_front (l.back ());
-                l.pop_back ();
-            }
+            patch_long (length_pos, m_buffer.size () - length_pos - 4);
         }
     }
 
@@ -574,8 +809,7 @@ bool midifile::write (perform * a_perf, int a_screen_set, int a_sequence)
         string * note = a_perf->get_screen_set_notepad (a_screen_set);
         write_short (note->length ());
 
-        for (unsigned int j = 0; j < note->length (); j++)
-            m_l.push_front ((*note)[j]);
+        m_buffer.insert (m_buffer.end (), note->begin (), note->end ());
     } else {
         write_long (c_notes);
         write_short (c_max_sets);
@@ -585,8 +819,7 @@ bool midifile::write (perform * a_perf, int a_screen_set, int a_sequence)
             string * note = a_perf->get_screen_set_notepad (i);
             write_short (note->length ());
 
-            for (unsigned int j = 0; j < note->length (); j++)
-                m_l.push_front ((*note)[j]);
+            m_buffer.insert (m_buffer.end (), note->begin (), note->end ());
         }
     }
 
@@ -599,24 +832,55 @@ bool midifile::write (perform * a_perf, int a_screen_set, int a_sequence)
      */
     long scaled_bpm = long(a_perf->get_bpm() * c_bpm_scale_factor);
     write_long (scaled_bpm);
+}
 
-    int data_size = m_l.size ();
-    m_d = (unsigned char *) new char[data_size];
 
-    m_pos = 0;
+/* writes next to the file and renames it over, so that a crash or a
+   full disk never leaves a half written file behind */
+bool midifile::write_buffer ()
+{
+    string tmp_name = m_name + ".tmp";
 
-    for (list < unsigned char >::reverse_iterator ri = m_l.rbegin ();
-            ri != m_l.rend (); ri++)
+    int fd = open (tmp_name.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening %s: %s\n", tmp_name.c_str (), strerror (errno));
+        return false;
+    }
+
+    /* one write for the whole file, unless interrupted */
+    size_t written = 0;
+    while (written < m_buffer.size ())
     {
-        m_d[m_pos++] = *ri;
+        ssize_t n = ::write (fd, m_buffer.data () + written, m_buffer.size () - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            break;
+        written += n;
     }
 
-    m_l.clear ();
+    bool ok = written == m_buffer.size () && fsync (fd) == 0;
+    ok = close (fd) == 0 && ok;
 
-    file.write ((char *) m_d, data_size);
-    file.close ();
+    if (ok && rename (tmp_name.c_str (), m_name.c_str ()) != 0)
+        ok = false;
+
+    if (!ok) {
+        fprintf(stderr, "Error writing %s: %s\n", m_name.c_str (), strerror (errno));
+        unlink (tmp_name.c_str ());
+        return false;
+    }
+
+    /* the rename is durable once the directory is */
+    size_t slash = m_name.rfind ('/');
+    string dir_name = slash == string::npos ? "." : slash == 0 ? "/" : m_name.substr (0, slash);
+    int dir_fd = open (dir_name.c_str (), O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0) {
+        fsync (dir_fd);
+        close (dir_fd);
+    }
 
-    delete[]m_d;
+    m_buffer.clear ();
 
     return true;
 }
@@ -18,29 +18,78 @@
 #define SEQ192_MIDIFILE
 
 #include "perform.h"
+#include <atomic>
 #include <fstream>
 #include <string>
 #include <list>
+#include <vector>
+#include <pthread.h>
+
+/* most threads decoding tracks at load */
+const size_t c_midifile_threads = 16;
+
+/* a track chunk of the file being parsed */
+struct midi_track
+{
+    int m_number;
+
+    /* byte range of the track data, after the chunk header */
+    size_t m_start;
+    size_t m_length;
+
+    /* decoded sequence, with what has to wait for the bus */
+    sequence *m_seq;
+    unsigned short m_perf;
+    int m_bus;
+    int m_channel;
+    bool m_ok;
+};
 
 class midifile
 {
 
  private:
 
-    int m_pos;
+    size_t m_pos;
     string m_name;
 
-    /* holds our data */
+    /* file being parsed, mapped read only */
     unsigned char *m_d;
+    size_t m_size;
+
+    /* set when a read ran past the end of the file */
+    bool m_truncated;
 
-    list<unsigned char> m_l;
+    /* file being written, in order */
+    vector<unsigned char> m_buffer;
 
+    /* reads past the end of the file return 0 and set m_truncated */
+    bool available( size_t a_n );
+    unsigned char read_byte();
     unsigned long read_long();
     unsigned short read_short();
     unsigned long read_var();
+    void skip( size_t a_n );
+
+    bool parse_data( perform *a_perf, int a_screen_set );
+    bool parse_track( unsigned short a_ppqn, midi_track *a_track );
+
+    /* tracks shared by the decoding threads */
+    struct decode_pool
+    {
+        midifile *m_file;
+        vector<midi_track> *m_tracks;
+        unsigned short m_ppqn;
+        atomic<size_t> m_next;
+    };
+
+    static void *decode_thread( void *a_pool );
+
+    void commit_track( perform *a_perf, midi_track *a_track, int a_num );
 
     void write_long( unsigned long );
     void write_short( unsigned short );
+    void patch_long( size_t a_pos, unsigned long a_x );
 
  public:
 
@@ -51,6 +100,16 @@ class midifile
     bool parse( perform *a_perf, int a_screen_set );
     bool write( perform *a_perf, int a_screen_set, int a_sequence);
 
+    /* write() in two steps: fill() copies the data out of a_perf,
+       write_buffer() then only touches the file and returns once
+       the data is on disk, from any thread */
+    void fill( perform *a_perf, int a_screen_set, int a_sequence );
+    bool write_buffer();
+
+    /* decodes a single track body, as written by
+       sequence::fill_buffer, into sequence a_num of a_perf */
+    bool load_track( perform *a_perf, unsigned char *a_data, size_t a_size, int a_num );
+
 };
 
 
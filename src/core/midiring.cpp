@@ -0,0 +1,65 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "midiring.h"
+
+midiring::midiring()
+{
+    m_events.resize( c_midiring_size );
+    m_seqs.resize( c_midiring_size );
+
+    m_head = 0;
+    m_tail = 0;
+    m_dropped = 0;
+}
+
+bool
+midiring::push( event *a_e, sequence *a_seq )
+{
+    size_t head = m_head.load( memory_order_relaxed );
+
+    if ( head - m_tail.load( memory_order_acquire ) >= c_midiring_size ){
+        m_dropped++;
+        return false;
+    }
+
+    m_events[head & (c_midiring_size - 1)] = *a_e;
+    m_seqs[head & (c_midiring_size - 1)] = a_seq;
+    m_head.store( head + 1, memory_order_release );
+
+    return true;
+}
+
+bool
+midiring::pop( event *a_e, sequence **a_seq )
+{
+    size_t tail = m_tail.load( memory_order_relaxed );
+
+    if ( tail == m_head.load( memory_order_acquire ))
+        return false;
+
+    *a_e = m_events[tail & (c_midiring_size - 1)];
+    *a_seq = m_seqs[tail & (c_midiring_size - 1)];
+    m_tail.store( tail + 1, memory_order_release );
+
+    return true;
+}
+
+long
+midiring::get_dropped()
+{
+    return m_dropped;
+}
@@ -0,0 +1,66 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SEQ192_MIDIRING
+#define SEQ192_MIDIRING
+
+#include <atomic>
+#include <vector>
+
+#include "event.h"
+#include "globals.h"
+
+class sequence;
+
+/* events the ring can hold, a power of two */
+const size_t c_midiring_size = 0x1000;
+
+/* fixed size queue handing incoming events, with the sequence they
+   are recorded in, from the thread reading ALSA to the thread
+   applying them. It is lock-free as long as there
+   is a single producer and a single consumer; events pushed while it
+   is full are dropped and counted. */
+class midiring
+{
+
+ private:
+
+    vector < event > m_events;
+    vector < sequence * > m_seqs;
+
+    /* next slot to write, only moved by the producer */
+    atomic < size_t > m_head;
+
+    /* next slot to read, only moved by the consumer */
+    atomic < size_t > m_tail;
+
+    atomic < long > m_dropped;
+
+ public:
+
+    midiring();
+
+    /* producer side, false if the ring is full */
+    bool push( event *a_e, sequence *a_seq );
+
+    /* consumer side, false if the ring is empty */
+    bool pop( event *a_e, sequence **a_seq );
+
+    /* events dropped since the start */
+    long get_dropped();
+};
+
+#endif
@@ -0,0 +1,219 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "midirouter.h"
+
+#include <sstream>
+#include <string.h>
+
+midirouter::midirouter()
+{
+    clear();
+}
+
+void
+midirouter::build()
+{
+    memset( m_port_slots, 0, sizeof(m_port_slots) );
+    memset( m_table, 0, sizeof(m_table) );
+
+    m_num_slots = 1;
+
+    for ( size_t i = 0; i < m_routes.size(); i++ ){
+
+        int port = m_routes[i].m_port;
+
+        if ( port >= 0 && m_port_slots[port] == 0 ){
+
+            if ( m_num_slots == c_midirouter_slots ){
+                fprintf( stderr, "Warning, too many recording ports, %d:%d ignored\n",
+                         port >> 8, port & 0xFF );
+                continue;
+            }
+
+            m_port_slots[port] = m_num_slots++;
+        }
+    }
+
+    for ( size_t i = 0; i < m_routes.size(); i++ ){
+
+        midiroute &r = m_routes[i];
+        uint32_t bit = 1u << i;
+
+        int slot_s = 0, slot_f = m_num_slots - 1;
+        if ( r.m_port >= 0 ){
+            slot_s = slot_f = m_port_slots[r.m_port];
+            if ( slot_s == 0 )
+                continue;
+        }
+
+        int channel_s = 0, channel_f = 16;
+        if ( r.m_channel >= 0 )
+            channel_s = channel_f = r.m_channel;
+
+        for ( int slot = slot_s; slot <= slot_f; slot++ ){
+            for ( int channel = channel_s; channel <= channel_f; channel++ ){
+
+                for ( int note = r.m_note_low; note <= r.m_note_high; note++ )
+                    m_table[slot][channel][note] |= bit;
+
+                m_table[slot][channel][128] |= bit;
+            }
+        }
+    }
+}
+
+bool
+midirouter::add( midiroute *a_route )
+{
+    midiroute r = *a_route;
+
+    if ( r.m_port > 0xFFFF ) r.m_port = -1;
+    if ( r.m_channel > 15 ) r.m_channel = -1;
+    if ( r.m_note_low < 0 ) r.m_note_low = 0;
+    if ( r.m_note_high > 127 ) r.m_note_high = 127;
+
+    for ( size_t i = 0; i < m_routes.size(); i++ ){
+
+        if ( m_routes[i].m_seq == r.m_seq ){
+            m_routes[i] = r;
+            build();
+            return true;
+        }
+    }
+
+    if ( (int) m_routes.size() == c_midirouter_routes )
+        return false;
+
+    m_routes.push_back( r );
+    build();
+
+    return true;
+}
+
+void
+midirouter::remove( sequence *a_seq )
+{
+    for ( size_t i = 0; i < m_routes.size(); i++ ){
+
+        if ( m_routes[i].m_seq == a_seq ){
+            m_routes.erase( m_routes.begin() + i );
+            build();
+            return;
+        }
+    }
+}
+
+void
+midirouter::clear()
+{
+    m_routes.clear();
+    build();
+}
+
+bool
+midirouter::empty()
+{
+    return m_routes.empty();
+}
+
+bool
+midirouter::has( sequence *a_seq )
+{
+    for ( size_t i = 0; i < m_routes.size(); i++ )
+        if ( m_routes[i].m_seq == a_seq )
+            return true;
+
+    return false;
+}
+
+void
+midirouter::get_sequences( vector < sequence * > *a_seqs )
+{
+    for ( size_t i = 0; i < m_routes.size(); i++ )
+        a_seqs->push_back( m_routes[i].m_seq );
+}
+
+void
+midirouter::route( int a_port, unsigned char a_status, unsigned char a_d0,
+                   vector < sequence * > *a_targets )
+{
+    a_targets->clear();
+
+    if ( m_routes.empty() )
+        return;
+
+    int slot = m_port_slots[a_port & 0xFFFF];
+    int channel = a_status < EVENT_SYSEX ? a_status & 0x0F : 16;
+    int note = 128;
+
+    unsigned char status = a_status & EVENT_CLEAR_CHAN_MASK;
+    if ( status == EVENT_NOTE_ON || status == EVENT_NOTE_OFF )
+        note = a_d0 & 0x7F;
+
+    uint32_t mask = m_table[slot][channel][note];
+
+    for ( int i = 0; mask != 0; i++, mask >>= 1 )
+        if ( mask & 1 )
+            a_targets->push_back( m_routes[i].m_seq );
+}
+
+bool
+midirouter::parse( const char *a_spec, midiroute *a_route )
+{
+    a_route->m_port = -1;
+    a_route->m_channel = -1;
+    a_route->m_note_low = 0;
+    a_route->m_note_high = 127;
+
+    stringstream spec( a_spec );
+    string item;
+
+    while ( getline( spec, item, ';' )){
+
+        stringstream args( item );
+        string name;
+
+        if ( !(args >> name) )
+            continue;
+
+        if ( name == "port" ){
+            int client, port;
+            char colon;
+            if ( !(args >> client >> colon >> port) || colon != ':' ||
+                 client < 0 || client > 0xFF || port < 0 || port > 0xFF )
+                return false;
+            a_route->m_port = client << 8 | port;
+        }
+        else if ( name == "channel" ){
+            int channel;
+            if ( !(args >> channel) || channel < 1 || channel > 16 )
+                return false;
+            a_route->m_channel = channel - 1;
+        }
+        else if ( name == "notes" ){
+            int low, high;
+            if ( !(args >> low >> high) || low < 0 || high > 127 || low > high )
+                return false;
+            a_route->m_note_low = low;
+            a_route->m_note_high = high;
+        }
+        else
+            return false;
+    }
+
+    return true;
+}
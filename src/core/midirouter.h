@@ -0,0 +1,94 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SEQ192_MIDIROUTER
+#define SEQ192_MIDIROUTER
+
+#include <stdint.h>
+#include <vector>
+
+#include "event.h"
+#include "globals.h"
+
+class sequence;
+
+/* sequences that can record at the same time */
+const int c_midirouter_routes = 32;
+
+/* input ports that can be named by routes, plus one for any port */
+const int c_midirouter_slots = 16;
+
+/* which events a sequence armed for recording takes */
+struct midiroute
+{
+    sequence *m_seq;
+
+    /* ALSA address of the sending port (client << 8 | port), -1 for any */
+    int m_port;
+
+    /* 0 to 15, -1 for any */
+    int m_channel;
+
+    /* applies to notes only */
+    int m_note_low;
+    int m_note_high;
+};
+
+/* dispatches incoming events to the sequences armed for recording.
+   The routes are compiled into a table giving, for each port slot,
+   channel and note, the bit mask of the matching routes, so that
+   routing an event is a couple of lookups whatever the number of
+   routes. Not locked, the master bus guards it. */
+class midirouter
+{
+
+ private:
+
+    vector < midiroute > m_routes;
+
+    /* port address -> slot, 0 is for ports no route names */
+    unsigned char m_port_slots[0x10000];
+    int m_num_slots;
+
+    /* slot, channel (16 for sysex), note (128 for other events) */
+    uint32_t m_table[c_midirouter_slots][17][129];
+
+    void build();
+
+ public:
+
+    midirouter();
+
+    /* arms a_route.m_seq, replacing its previous route,
+       false if there are too many routes already */
+    bool add( midiroute *a_route );
+    void remove( sequence *a_seq );
+    void clear();
+
+    bool empty();
+    bool has( sequence *a_seq );
+    void get_sequences( vector < sequence * > *a_seqs );
+
+    /* fills a_targets with the sequences taking the event */
+    void route( int a_port, unsigned char a_status, unsigned char a_d0,
+                vector < sequence * > *a_targets );
+
+    /* reads a route like "port 20:0; channel 1; notes 36 59", missing
+       fields match everything, channels are numbered 1 to 16 */
+    static bool parse( const char *a_spec, midiroute *a_route );
+};
+
+#endif
@@ -37,6 +37,12 @@ smutex::unlock( )
     pthread_mutex_unlock( &m_mutex_lock );
 }
 
+bool
+smutex::try_lock( )
+{
+    return pthread_mutex_trylock( &m_mutex_lock ) == 0;
+}
+
 condition_var::condition_var( )
 {
     m_cond = cond;
@@ -54,3 +60,19 @@ condition_var::wait( )
 {
     pthread_cond_wait( &m_cond, &m_mutex_lock );
 }
+
+bool
+condition_var::timed_wait( long a_us )
+{
+    struct timespec until;
+    clock_gettime( CLOCK_REALTIME, &until );
+
+    until.tv_sec += a_us / 1000000;
+    until.tv_nsec += (a_us % 1000000) * 1000;
+    if ( until.tv_nsec >= 1000000000 ){
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+
+    return pthread_cond_timedwait( &m_cond, &m_mutex_lock, &until ) == 0;
+}
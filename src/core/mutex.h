@@ -38,6 +38,9 @@ public:
     void lock();
     void unlock();
 
+    /* returns false instead of waiting if another thread holds it */
+    bool try_lock();
+
 };
 
 class condition_var : public smutex {
@@ -55,6 +58,9 @@ public:
     void wait();
     void signal();
 
+    /* false if a_us went by without a signal */
+    bool timed_wait( long a_us );
+
 };
 
 #endif
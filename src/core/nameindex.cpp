@@ -0,0 +1,87 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+#include <algorithm>
+#include <string.h>
+#include <lo/lo.h>
+
+#include "nameindex.h"
+#include "sequence.h"
+
+nameindex::nameindex()
+{
+    m_version = 0;
+    m_valid = false;
+}
+
+bool
+nameindex::is_current( long a_version )
+{
+    return m_valid && m_version == a_version;
+}
+
+/* characters with a meaning in osc address patterns */
+bool
+nameindex::is_pattern( const char *a_pattern )
+{
+    return strpbrk( a_pattern, "*?[]{}" ) != NULL;
+}
+
+void
+nameindex::build( sequence **a_seqs, bool *a_active, int a_count, long a_version )
+{
+    m_names.clear();
+    m_patterns.clear();
+
+    for ( int i = 0; i < a_count; i++ ){
+        if ( a_seqs[i] != NULL && a_active[i] )
+            m_names[ a_seqs[i]->get_name() ].push_back( i );
+    }
+
+    m_version = a_version;
+    m_valid = true;
+}
+
+const vector < int > &
+nameindex::find( const char *a_pattern )
+{
+    if ( !is_pattern( a_pattern )){
+        unordered_map < string, vector < int > >::iterator n = m_names.find( a_pattern );
+        return n == m_names.end() ? m_none : n->second;
+    }
+
+    unordered_map < string, vector < int > >::iterator p = m_patterns.find( a_pattern );
+    if ( p != m_patterns.end() )
+        return p->second;
+
+    if ( m_patterns.size() >= c_nameindex_patterns )
+        m_patterns.clear();
+
+    vector < int > &seqs = m_patterns[ a_pattern ];
+
+    /* match each distinct name once */
+    unordered_map < string, vector < int > >::iterator n;
+    for ( n = m_names.begin(); n != m_names.end(); n++ ){
+        if ( lo_pattern_match( n->first.c_str(), a_pattern ))
+            seqs.insert( seqs.end(), n->second.begin(), n->second.end() );
+    }
+
+    sort( seqs.begin(), seqs.end() );
+
+    return seqs;
+}
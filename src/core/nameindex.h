@@ -0,0 +1,68 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+#ifndef SEQ192_NAMEINDEX
+#define SEQ192_NAMEINDEX
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "globals.h"
+
+class sequence;
+
+/* patterns kept in the cache, it is emptied when full */
+const size_t c_nameindex_patterns = 0x1000;
+
+/* maps sequence names, and the osc patterns matched against them,
+   to sequence numbers across every screen set. The owner rebuilds it
+   when its version (bumped on rename, add and delete) moves. */
+class nameindex
+{
+
+ private:
+
+    /* exact name -> sequences */
+    unordered_map < string, vector < int > > m_names;
+
+    /* pattern -> sequences whose name matches, filled on demand */
+    unordered_map < string, vector < int > > m_patterns;
+
+    vector < int > m_none;
+
+    long m_version;
+    bool m_valid;
+
+    static bool is_pattern( const char *a_pattern );
+
+ public:
+
+    nameindex();
+
+    bool is_current( long a_version );
+
+    /* a_seqs holds a_count sequences, NULL or inactive ones are skipped */
+    void build( sequence **a_seqs, bool *a_active, int a_count, long a_version );
+
+    /* sequences named a_pattern, or matching it if it is an osc
+       pattern, in ascending order */
+    const vector < int > &find( const char *a_pattern );
+};
+
+#endif
@@ -21,41 +21,42 @@ OSCServer::OSCServer( const char* port )
     protocol = std::string(port).find(std::string("osc.unix")) != std::string::npos ? LO_UNIX : LO_DEFAULT;
 
     if (protocol == LO_UNIX) {
-        serverThread = lo_server_thread_new_from_url(port, error);
+        server = lo_server_new_from_url(port, error);
     } else {
-        serverThread = lo_server_thread_new(port, error);
+        server = lo_server_new(port, error);
     }
 
-    if (!serverThread) {
+    if (!server) {
         exit(1);
     }
 
-	server = lo_server_thread_get_server( serverThread );
+    // bundles are dispatched on arrival, seq192 waits for their timetag
+    // (see perform::osc_defer), so that launches can be scheduled by tick
+    lo_server_enable_queue(server, 0, 1);
 }
 
 OSCServer::~OSCServer()
 {
-    if (serverThread) {
-        stop();
-        lo_server_thread_free( serverThread );
+    if (server) {
+        lo_server_free( server );
     }
 }
 
-void OSCServer::start()
+int OSCServer::get_fd()
 {
-    lo_server_thread_start( serverThread );
+    return lo_server_get_socket_fd( server );
 }
 
 
-void OSCServer::stop()
+void OSCServer::process()
 {
-    lo_server_thread_stop( serverThread );
+    while (lo_server_recv_noblock( server, 0 ) > 0) {}
 }
 
 
 void OSCServer::add_method( const char* path, const char* types, lo_method_handler h, void* user_data)
 {
-    lo_server_thread_add_method( serverThread, path, types, h, user_data );
+    lo_server_add_method( server, path, types, h, user_data );
 }
 
 void OSCServer::send_json( const char* address, const char* path, const char* json)
@@ -70,3 +71,10 @@ void OSCServer::send_json( const char* address, const char* path, const char* js
     }
 
 }
+
+void OSCServer::send_json_to( lo_address address, const char* path, const char* json)
+{
+    lo_server from = protocol == LO_UNIX ? NULL : server;
+
+    lo_send_from(address, from, LO_TT_IMMEDIATE, path, "s", json);
+}
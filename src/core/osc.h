@@ -33,13 +33,14 @@ public:
     int protocol;
 
 
-    void start();
-    void stop();
+    /* socket to wait on, process() handles what arrived */
+    int get_fd();
+    void process();
 
     void add_method (const char* path, const char* types, lo_method_handler h, void* user_data = NULL);
     void send_json(const char* address, const char *path, const char* json);
+    void send_json_to(lo_address address, const char *path, const char* json);
 
-    lo_server_thread serverThread;
     lo_server server;
 
     static void error(int num, const char *msg, const char *path)
@@ -19,8 +19,12 @@
 #include "midibus.h"
 #include "event.h"
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <sched.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
 
 
 bool global_is_modified = false;
@@ -33,13 +37,34 @@ perform::perform()
         m_seqs_active[i] = false;
     }
 
+    for (int i = 0; i < (c_max_sequence + 63) / 64; i++) {
+        m_active_bits[i] = 0;
+        m_deactivated_bits[i] = 0;
+    }
+
     m_running = false;
     m_stopping = false;
     m_looping = false;
-    m_inputing = true;
+    m_control_timer = false;
+    m_active_changes = 0;
+    osc_push_timer = -1;
+    osc_defer_timer = -1;
+    osc_replaying = false;
+    osc_pushed_valid = false;
     m_outputing = true;
     m_tick = -1;
 
+    m_input_batch.reserve( c_midiring_size );
+    m_input_batch_seqs.reserve( c_midiring_size );
+    m_input_seq_events.reserve( c_midiring_size );
+    m_input_dropped = 0;
+
+    m_recording_input = true;
+    m_record_thread_launched = false;
+    m_record_wake = eventfd(0, EFD_CLOEXEC);
+    if (m_record_wake < 0)
+        fprintf(stderr, "eventfd() error: %s, recording from the output thread\n", strerror(errno));
+
     // m_key_start  = GDK_space;
     // m_key_stop   = GDK_Escape;
 
@@ -51,6 +76,24 @@ perform::perform()
 
     m_out_thread_launched = false;
     m_in_thread_launched = false;
+
+    m_save_thread_launched = false;
+    m_save_file = NULL;
+    m_save_state = E_SAVE_IDLE;
+
+    m_journal_thread_launched = false;
+    m_journaling = false;
+    m_journal_open = false;
+    m_journal_clock = -1;
+    m_journal_changes_seen = -1;
+    m_journal_changes = 0;
+    m_journal_save_base = NULL;
+    m_journal_bpm = 0;
+    for (int i = 0; i < c_max_sequence; i++) {
+        m_journal_stamps[i] = 0;
+        m_journal_hashes[i] = 0;
+        m_journal_active[i] = false;
+    }
 }
 
 void
@@ -92,7 +135,46 @@ perform::panic()
             m_seqs[i]->off_queued();
         }
     }
-}
+
+    // notes held through the input, whatever sequence they came from
+    m_master_bus.off_thru_notes(NULL);
+
+    // and what waits behind a sysex dump
+    m_master_bus.abort_sysex();
+}
+
+
+// osc commands and their argument types, NULL when the command takes a
+// variable argument list (checked by osc_callback). Commands ignoring
+// their arguments accept any, buttons usually send a value
+static const struct {
+    const char *path;
+    const char *types;
+    int command;
+} osc_methods[] = {
+    {"/play",               NULL,   perform::SEQ_PLAY},
+    {"/stop",               NULL,   perform::SEQ_STOP},
+    {"/bpm",                "i",    perform::SEQ_BPM},
+    {"/bpm",                "f",    perform::SEQ_BPM},
+    {"/screenset",          "i",    perform::SEQ_SSET},
+    {"/panic",              NULL,   perform::SEQ_PANIC},
+    {"/sequence",           NULL,   perform::SEQ_SSEQ},
+    {"/sequence/trig",      NULL,   perform::SEQ_SSEQ_AND_PLAY},
+    {"/sequence/queue",     NULL,   perform::SEQ_SSEQ_QUEUED},
+    {"/status",             "",     perform::SEQ_STATUS},
+    {"/status",             "s",    perform::SEQ_STATUS},
+    {"/status/extended",    "",     perform::SEQ_STATUS_EXT},
+    {"/status/extended",    "s",    perform::SEQ_STATUS_EXT},
+    {"/sequence/transform", NULL,   perform::SEQ_TRANSFORM},
+    {"/sequence/record",    NULL,   perform::SEQ_RECORD},
+    {"/control/learn",      NULL,   perform::SEQ_CONTROL_LEARN},
+    {"/sequence/batch",     NULL,   perform::SEQ_BATCH},
+    {"/control/clear",      NULL,   perform::SEQ_CONTROL_CLEAR},
+    {"/subscribe",          "",     perform::SEQ_SUBSCRIBE},
+    {"/subscribe",          "s",    perform::SEQ_SUBSCRIBE},
+    {"/unsubscribe",        "",     perform::SEQ_UNSUBSCRIBE},
+    {"/unsubscribe",        "s",    perform::SEQ_UNSUBSCRIBE}
+};
 
 
 void perform::init()
@@ -100,19 +182,89 @@ void perform::init()
     m_master_bus.init();
     m_clipboard.set_master_midi_bus(get_master_midi_bus());
 
+    for (size_t i = 0; i < global_user_midi_controls.size(); i++) {
+        user_midi_control *control = &global_user_midi_controls[i];
+        control_action action;
+        if (!midicontrol::parse_action(control->action, &action) || control->value < 0 ||
+            control->channel < 0 || control->channel > 15 ||
+            control->entry < 0 || control->entry >= c_midicontrol_entries) {
+            fprintf(stderr, "Warning, ignoring invalid midi control (%s)\n", control->action.c_str());
+            continue;
+        }
+        m_controls.set(control->channel, control->entry, action, control->value);
+        start_control_timer();
+    }
+
+    // sysex dumps go on while nothing plays
+    if (m_master_bus.get_sysex_timer() >= 0) {
+        m_reactor.add(m_master_bus.get_sysex_timer(), &perform::sysex_timer_callback, this);
+    }
+
+    struct pollfd *fds;
+    int num_fds = m_master_bus.get_poll_descriptors(&fds);
+    for (int i = 0; i < num_fds; i++) {
+        m_reactor.add(fds[i].fd, &perform::input_callback, this);
+    }
+
     if (global_oscport != 0) {
         oscserver = new OSCServer(global_oscport);
-        oscserver->start();
-        oscserver->add_method(NULL, NULL, &perform::osc_callback, this);
+
+        // one method per command, unknown paths are dropped by liblo
+        int num_methods = sizeof(osc_methods) / sizeof(osc_methods[0]);
+        osc_bindings.resize(num_methods);
+        for (int i = 0; i < num_methods; i++) {
+            osc_bindings[i].m_perform = this;
+            osc_bindings[i].m_command = osc_methods[i].command;
+            oscserver->add_method(osc_methods[i].path, osc_methods[i].types, &perform::osc_callback, &osc_bindings[i]);
+        }
+        if (!m_reactor.add(oscserver->get_fd(), &perform::osc_input_callback, this)) {
+            fprintf(stderr, "Warning, osc server can't be polled\n");
+        }
+    }
+
+}
+
+int perform::osc_seq_mode(const char *a_mode)
+{
+    switch (a_mode[0]) {
+        case 'c':
+            if (!strcmp(a_mode, "copy")) return SEQ_MODE_COPY;
+            if (!strcmp(a_mode, "cut")) return SEQ_MODE_CUT;
+            if (!strcmp(a_mode, "clear")) return SEQ_MODE_CLEAR;
+            break;
+        case 'd':
+            if (!strcmp(a_mode, "delete")) return SEQ_MODE_DELETE;
+            break;
+        case 'o':
+            if (!strcmp(a_mode, "on")) return SEQ_MODE_ON;
+            if (!strcmp(a_mode, "off")) return SEQ_MODE_OFF;
+            break;
+        case 'p':
+            if (!strcmp(a_mode, "paste")) return SEQ_MODE_PASTE;
+            break;
+        case 'r':
+            if (!strcmp(a_mode, "record")) return SEQ_MODE_RECORD;
+            if (!strcmp(a_mode, "record_on")) return SEQ_MODE_RECORD_ON;
+            if (!strcmp(a_mode, "record_off")) return SEQ_MODE_RECORD_OFF;
+            break;
+        case 's':
+            if (!strcmp(a_mode, "solo")) return SEQ_MODE_SOLO;
+            break;
+        case 't':
+            if (!strcmp(a_mode, "toggle")) return SEQ_MODE_TOGGLE;
+            break;
     }
 
+    return 0;
 }
 
+
 int perform::osc_callback(const char *path, const char *types, lo_arg ** argv,
                 int argc, void *data, void *user_data)
 {
 
-    perform *self = (perform *)user_data;
+    osc_binding *binding = (osc_binding *)user_data;
+    perform *self = binding->m_perform;
 
     // debug
     // int i;
@@ -125,8 +277,10 @@ int perform::osc_callback(const char *path, const char *types, lo_arg ** argv,
     // printf("\n");
     // fflush(stdout);
 
-    int command = self->osc_commands[(std::string) path];
-    if (!command) return 0;
+    int command = binding->m_command;
+
+    // future timetag: waits for its time, unless it's scheduled by tick
+    if (self->osc_defer(path, types, argv, argc, data, binding)) return 0;
 
     switch (command) {
         case SEQ_PLAY:
@@ -158,60 +312,19 @@ int perform::osc_callback(const char *path, const char *types, lo_arg ** argv,
             if (argc < 1 || types[0] != 's') return 0;
 
             // arg 0: mode
-            int mode = self->osc_seq_modes[(std::string) &argv[0]->s];
+            int mode = osc_seq_mode(&argv[0]->s);
             if (!mode) return 1;
 
-            for (int i = 0; i < c_mainwnd_rows * c_mainwnd_cols; i++) {
-                self->osc_selected_seqs[i] = 0;
-            }
-
-            if (mode == SEQ_MODE_RECORD_OFF) {
+            if (mode == SEQ_MODE_RECORD_OFF && argc == 1) {
                 self->get_master_midi_bus()->set_sequence_input(NULL);
                 return 0;
             }
 
-            if (argc < 2) return 0;
-
-            // sequence selection
-            if (types[1] == 'i') {
-                // arg 1: column number
-
-                int col = argv[1]->i;
-                if (col < 0 || col > c_mainwnd_cols) return 0;
-
-                if (argc == 2) {
-                    // select all rows in column
-                    for (int i = 0; i < c_mainwnd_rows; i++) {
-                        self->osc_selected_seqs[i + col * c_mainwnd_rows] = 1;
-                    }
-                } else {
-                    // select some rows in column
-                    for (int i = 2; i < argc; i++) {
-                        if (types[i] == 'i') {
-                            int row = argv[i]->i;
-                            if (row < c_mainwnd_rows) {
-                                self->osc_selected_seqs[row + col * c_mainwnd_rows] = 1;
-                            }
-                        }
-                    }
-                }
-
-            } else if (types[1] == 's') {
-                // arg 1...n: sequences names / osc pattern
-
-                for (int i = 0; i < c_mainwnd_cols * c_mainwnd_rows; i++) {
-                    int nseq = i + self->m_screen_set * c_mainwnd_cols * c_mainwnd_rows;
-                    if (self->is_active(nseq)) {
-                        for (int j = 1; j < argc; j++) {
-                            if (types[j] == 's' && lo_pattern_match(self->m_seqs[nseq]->get_name(), &argv[j]->s)) {
-                                self->osc_selected_seqs[i] = 1;
-                                break;
-                            }
-                        }
-                    }
-                }
+            // arg 1...n: sequence selection
+            if (!self->osc_select_sequences(types, argv, argc, 1)) return 0;
 
-            }
+            // bundle launching sequences at a given time
+            if (command == SEQ_SSEQ && mode <= SEQ_MODE_TOGGLE && self->osc_schedule(data, mode)) break;
 
             if (mode == SEQ_MODE_SOLO) {
                 for (int i = 0; i < c_max_sequence; i++) {
@@ -260,13 +373,22 @@ int perform::osc_callback(const char *path, const char *types, lo_arg ** argv,
                                 }
                                 break;
                             case SEQ_MODE_RECORD:
-                                self->get_master_midi_bus()->set_sequence_input(self->m_seqs[nseq]->get_recording() ? NULL : self->m_seqs[nseq]);
-                                return 0;
+                                if (self->m_seqs[nseq]->get_recording()) {
+                                    self->get_master_midi_bus()->remove_sequence_input(self->m_seqs[nseq]);
+                                    break;
+                                }
+                                // fall through
                             case SEQ_MODE_RECORD_ON:
-                                self->get_master_midi_bus()->set_sequence_input(self->m_seqs[nseq]);
-                                // only one sequence can be armed for recording
-                                // ignore matching sequences after the first
-                                return 0;
+                            {
+                                midiroute route;
+                                midirouter::parse("", &route);
+                                route.m_seq = self->m_seqs[nseq];
+                                self->get_master_midi_bus()->add_sequence_input(&route);
+                                break;
+                            }
+                            case SEQ_MODE_RECORD_OFF:
+                                self->get_master_midi_bus()->remove_sequence_input(self->m_seqs[nseq]);
+                                break;
                             case SEQ_MODE_CLEAR:
                                 self->m_seqs[nseq]->select_all();
                                 self->m_seqs[nseq]->mark_selected();
@@ -303,226 +425,939 @@ int perform::osc_callback(const char *path, const char *types, lo_arg ** argv,
 
             break;
         }
-        case SEQ_STATUS:
-        case SEQ_STATUS_EXT:
-            char *address;
-            if (argc == 1) {
-                address = &argv[0]->s;
-            } else {
-                address = lo_address_get_url(lo_message_get_source(data));
-            }
-            self->osc_status(address, path);
-            break;
-
-    }
-
-
-    return 0;
-}
+        case SEQ_TRANSFORM:
+        {
+            if (argc < 1 || types[0] != 's') return 0;
 
+            // arg 0: transforms, eg "quantize 48; transpose -12"
+            eventtransform chain;
+            if (!chain.parse(&argv[0]->s)) return 1;
 
-void perform::osc_status( char* address, const char* path)
-{
+            // arg 1...n: sequence selection
+            if (!self->osc_select_sequences(types, argv, argc, 1)) return 0;
 
-    int command = osc_commands[(std::string) path];
+            for (int i = 0; i < c_mainwnd_rows * c_mainwnd_cols; i++) {
+                if (self->osc_selected_seqs[i] == 1) {
+                    int nseq = i + self->m_screen_set * c_mainwnd_cols * c_mainwnd_rows;
+                    if (nseq < c_max_sequence && self->is_active(nseq)) {
+                        if (self->m_seqs[nseq]->apply_transforms(&chain, false)) {
+                            global_is_modified = true;
+                        }
+                    }
+                }
+            }
 
-    std::string json = "{";
+            break;
+        }
+        case SEQ_RECORD:
+        {
+            if (argc < 1 || types[0] != 's') return 0;
 
-    json += "\"playing\":" + std::to_string(m_running) + ",";
-    json += "\"screenset\":" + std::to_string(m_screen_set) + ",";
-    json += "\"screensetName\":\"" + (std::string)get_screen_set_notepad(m_screen_set)->c_str() + "\",";
-    json += "\"tick\":\"" + std::to_string(get_tick()) + "\",";
-    json += "\"bpm\":\"" + std::to_string(get_bpm()) + "\"";
+            // arg 0: route, eg "port 20:0; channel 1; notes 36 59"
+            midiroute route;
+            if (!midirouter::parse(&argv[0]->s, &route)) return 1;
 
-    if (command == SEQ_STATUS_EXT) {
+            // arg 1...n: sequence selection
+            if (!self->osc_select_sequences(types, argv, argc, 1)) return 0;
 
-        json += ",\"sequences\":[";
-        bool empty = true;
-        for (int col = 0; col < c_mainwnd_cols; col++) {
-            for (int row = 0; row < c_mainwnd_rows; row++) {
-                int nseq = row + col * c_mainwnd_rows + m_screen_set * c_mainwnd_cols * c_mainwnd_rows;
-                if (is_active(nseq)) {
-                    empty = false;
-                    json += "{";
-                    json += "\"col\":" + std::to_string(col) + ",";
-                    json += "\"row\":" + std::to_string(row) + ",";
-                    json += "\"name\":\"" + (std::string)m_seqs[nseq]->get_name() + "\",";
-                    json += "\"time\":\"" + std::to_string(m_seqs[nseq]->get_bpm()) + "/" + std::to_string(m_seqs[nseq]->get_bw()) + "\",";
-                    json += "\"bars\":" + std::to_string((int)((double)m_seqs[nseq]->get_length() / c_ppqn / m_seqs[nseq]->get_bpm() * (m_seqs[nseq]->get_bw() / 4))) + ",";
-                    json += "\"ticks\":" + std::to_string(m_seqs[nseq]->get_length()) + ",";
-                    json += "\"queued\":" + std::to_string(m_seqs[nseq]->get_queued()) + ",";
-                    json += "\"playing\":" + std::to_string(m_seqs[nseq]->get_playing()) + ",";
-                    json += "\"timesPlayed\":" + std::to_string(m_seqs[nseq]->get_times_played()) + ",";
-                    json += "\"recording\":" + std::to_string(m_seqs[nseq]->get_recording());
-                    json += "},";
+            for (int i = 0; i < c_mainwnd_rows * c_mainwnd_cols; i++) {
+                if (self->osc_selected_seqs[i] == 1) {
+                    int nseq = i + self->m_screen_set * c_mainwnd_cols * c_mainwnd_rows;
+                    if (nseq < c_max_sequence && self->is_active(nseq)) {
+                        route.m_seq = self->m_seqs[nseq];
+                        if (!self->get_master_midi_bus()->add_sequence_input(&route)) {
+                            fprintf(stderr, "Warning, too many sequences armed for recording\n");
+                        }
+                    }
                 }
             }
+
+            break;
         }
+        case SEQ_BATCH:
+        {
+            // args: pairs of sequence number (any screenset) or name
+            // pattern, and mode
+            launch l;
+            l.m_solo = false;
 
-        if (!empty) json = json.substr(0, json.size() - 1);
+            int matched = 0;
+            std::string errors = "";
 
-        json += "]";
+            for (int i = 0; i < argc; i += 2) {
 
-    }
+                int mode = i + 1 < argc && types[i + 1] == 's' ? osc_seq_mode(&argv[i + 1]->s) : 0;
+                if (mode == 0 || mode > SEQ_MODE_TOGGLE) {
+                    errors += "{\"pair\":" + std::to_string(i / 2) + ",\"error\":\"invalid mode\"},";
+                    continue;
+                }
+                if (mode == SEQ_MODE_SOLO) {
+                    l.m_solo = true;
+                    mode = SEQ_MODE_ON;
+                }
 
-    json += "}";
+                size_t before = l.m_seqs.size();
 
-    oscserver->send_json(address, path, json.c_str());
+                if (types[i] == 'i') {
+                    int nseq = argv[i]->i;
+                    if (nseq >= 0 && nseq < c_max_sequence && self->is_active(nseq)) {
+                        l.m_seqs.push_back(make_pair(nseq, mode));
+                    }
+                } else if (types[i] == 's') {
+                    const vector<int> &seqs = self->find_sequences(&argv[i]->s);
+                    for (size_t k = 0; k < seqs.size(); k++) {
+                        l.m_seqs.push_back(make_pair(seqs[k], mode));
+                    }
+                }
 
-}
+                if (l.m_seqs.size() == before) {
+                    errors += "{\"pair\":" + std::to_string(i / 2) + ",\"error\":\"no sequence\"},";
+                }
+                matched += l.m_seqs.size() - before;
+            }
 
-#ifdef USE_JACK
-void perform::init_jack()
-{
-    if ( global_with_jack_transport  && !m_jack_running)
-    {
-        m_jack_running = true;
-        //printf ( "init_jack() m_jack_running[%d]\n", m_jack_running );
+            // resolved once, applied by a single cycle
+            long tick = -1;
+            bool dropped = !self->osc_launch_tick(data, &tick);
+            if (!dropped && !l.m_seqs.empty()) {
+                tick = self->add_launch(tick, &l);
+            }
 
-        do
+            std::string json = "{";
+            json += "\"sequences\":" + std::to_string(dropped ? 0 : matched) + ",";
+            json += "\"dropped\":" + std::to_string(dropped) + ",";
+            json += "\"tick\":" + std::to_string(tick) + ",";
+            json += "\"errors\":[" + errors.substr(0, errors.size() > 0 ? errors.size() - 1 : 0) + "]";
+            json += "}";
+
+            self->oscserver->send_json(self->osc_source_url(data).c_str(), path, json.c_str());
+            break;
+        }
+        case SEQ_CONTROL_LEARN:
         {
-            // register as a jack client
-            // only to retreive transport state changes and time
+            if (argc < 1 || types[0] != 's') return 0;
 
-            m_jack_client = jack_client_open(global_client_name.c_str(), JackNullOption, NULL );
+            control_action action;
+            if (!midicontrol::parse_action(&argv[0]->s, &action)) return 0;
 
-            if (m_jack_client == 0)
-            {
-                printf( "JACK server is not running.\n[JACK sync disabled]\n");
-                m_jack_running = false;
-                break;
+            // arg 1...n: col and row, row, screen set or base tempo
+            int values[2] = {0, 0};
+            for (int i = 1; i < argc && i < 3; i++) {
+                if (types[i] == 'i') values[i - 1] = argv[i]->i;
+                else if (types[i] == 'f') values[i - 1] = argv[i]->f;
+                else return 0;
             }
 
-            jack_on_shutdown( m_jack_client, jack_shutdown,(void *) this );
-            jack_set_process_callback(m_jack_client, jack_process_callback, (void *) this);
+            int value = values[0];
+            if (action == CONTROL_TOGGLE || action == CONTROL_QUEUE) {
+                if (argc < 3) return 0;
+                value = values[1] + values[0] * c_mainwnd_rows;
+            }
+            if (value < 0) return 0;
 
-            if (jack_activate(m_jack_client))
-            {
-                printf("Cannot register as JACK client\n");
-                m_jack_running = false;
-                break;
+            self->m_controls.learn(action, value);
+            self->start_control_timer();
+            break;
+        }
+        case SEQ_CONTROL_CLEAR:
+            self->m_controls.clear();
+            break;
+        case SEQ_SUBSCRIBE:
+        case SEQ_UNSUBSCRIBE:
+        {
+            std::string url;
+            if (argc == 0) {
+                url = self->osc_source_url(data);
+            }
+            const char *address = argc == 1 ? &argv[0]->s : url.c_str();
+            if (command == SEQ_SUBSCRIBE) {
+                self->osc_subscribe(address);
+            } else {
+                self->osc_unsubscribe(address);
             }
+            break;
         }
-        while (0);
+        case SEQ_STATUS:
+        case SEQ_STATUS_EXT:
+        {
+            std::string address = argc == 1 ? std::string(&argv[0]->s) : self->osc_source_url(data);
+            self->osc_status(address.c_str(), path, command);
+            break;
+        }
+
     }
 
+
+    return 0;
 }
 
 
-void perform::deinit_jack()
+// tick a timetagged message is due, -1 to apply it at once;
+// false if it came late and must be dropped
+bool perform::osc_launch_tick(lo_message a_message, long *a_tick)
 {
-    if (global_with_jack_transport) {
+    *a_tick = -1;
 
-        if (m_jack_running) {
+    // deferred until its time: due now
+    if (osc_replaying) return true;
 
-            //printf ( "deinit_jack() m_jack_running[%d]\n", m_jack_running );
+    lo_timetag timetag = lo_message_get_timestamp(a_message);
 
-            m_jack_running = false;
+    if (timetag.sec == LO_TT_IMMEDIATE.sec && timetag.frac == LO_TT_IMMEDIATE.frac) return true;
 
-            if (jack_client_close(m_jack_client)) {
-                printf("Cannot close JACK client.\n");
-            }
+    lo_timetag now;
+    lo_timetag_now(&now);
+    double delay = lo_timetag_diff(timetag, now);
 
-        }
+    struct timespec system_time;
+    clock_gettime(CLOCK_MONOTONIC, &system_time);
+    long long now_us = system_time.tv_sec * 1000000LL + system_time.tv_nsec / 1000;
 
-        if (!m_jack_running){
-            printf( "[JACK sync disabled]\n");
-        }
+    // stopped: there's no tick to wait for
+    double tick = get_tick_at(now_us);
+    if (tick < 0) return true;
 
+    if (delay > 0) {
+        *a_tick = get_tick_at(now_us + (long long)(delay * 1e6));
+        return true;
     }
-}
-void jack_shutdown(void *arg)
-{
-    perform *p = (perform *) arg;
-    p->m_jack_running = false;
 
-    printf("JACK shut down.\nJACK sync Disabled.\n");
+    switch (global_late_bundles) {
+        case E_LATE_BUNDLE_BAR:
+            *a_tick = ((long) tick / (c_ppqn * 4) + 1) * (c_ppqn * 4);
+            return true;
+        case E_LATE_BUNDLE_DROP:
+            return false;
+        default:
+            return true;
+    }
 }
-#endif
 
-void perform::clear_all()
+
+bool perform::osc_defer(const char *a_path, const char *a_types, lo_arg **a_argv, int a_argc,
+                        lo_message a_message, osc_binding *a_binding)
 {
-    reset_sequences();
+    if (osc_replaying) return false;
 
-    for (int i=0; i< c_max_sequence; i++ ){
+    lo_timetag timetag = lo_message_get_timestamp(a_message);
+    if (timetag.sec == LO_TT_IMMEDIATE.sec && timetag.frac == LO_TT_IMMEDIATE.frac) return false;
 
-        if ( is_active(i) )
-            delete_sequence( i );
+    lo_timetag now;
+    lo_timetag_now(&now);
+    double delay = lo_timetag_diff(timetag, now);
+
+    // late: applied at once, launches follow lateBundles
+    if (delay <= 0) return false;
+
+    // while playing, launches go to the tick they are due at
+    int command = a_binding->m_command;
+    if (m_tick >= 0) {
+        if (command == SEQ_BATCH) return false;
+        if (command == SEQ_SSEQ && a_argc > 0 && a_types[0] == 's') {
+            int mode = osc_seq_mode(&a_argv[0]->s);
+            if (mode != 0 && mode <= SEQ_MODE_TOGGLE) return false;
+        }
     }
 
-    string e( "" );
+    if (osc_defer_timer < 0) {
+        osc_defer_timer = m_reactor.add_timer(0, &perform::osc_defer_callback, this);
+        if (osc_defer_timer < 0) return false;
+    }
 
-    for (int i=0; i<c_max_sets; i++ ){
-        set_screen_set_notepad( i, &e );
+    struct timespec system_time;
+    clock_gettime(CLOCK_MONOTONIC, &system_time);
+    long long due_us = system_time.tv_sec * 1000000LL + system_time.tv_nsec / 1000 + (long long)(delay * 1e6);
+
+    osc_deferred deferred;
+    deferred.m_path = a_path;
+    deferred.m_message = lo_message_clone(a_message);
+    deferred.m_source = osc_source_url(a_message);
+    deferred.m_binding = a_binding;
+
+    bool first = osc_deferred_messages.empty() || due_us < osc_deferred_messages.begin()->first;
+    osc_deferred_messages.insert(make_pair(due_us, deferred));
+
+    if (first) {
+        long wait = due_us - (system_time.tv_sec * 1000000LL + system_time.tv_nsec / 1000);
+        m_reactor.set_timer(osc_defer_timer, wait > 0 ? wait : 1);
     }
+
+    return true;
 }
 
-perform::~perform()
-{
 
-    stop();
+// runs the deferred messages that are due, in time order
+void perform::osc_replay()
+{
+    struct timespec system_time;
+    clock_gettime(CLOCK_MONOTONIC, &system_time);
+    long long now_us = system_time.tv_sec * 1000000LL + system_time.tv_nsec / 1000;
 
-    m_inputing = false;
-    m_outputing = false;
-    m_running = false;
+    while (!osc_deferred_messages.empty() && osc_deferred_messages.begin()->first <= now_us) {
 
-    m_running_lock.signal();
-    m_stopping_lock.signal();
+        osc_deferred deferred = osc_deferred_messages.begin()->second;
+        osc_deferred_messages.erase(osc_deferred_messages.begin());
 
-    if (m_out_thread_launched )
-        pthread_join( m_out_thread, NULL );
+        osc_replaying = true;
+        osc_replay_source = deferred.m_source;
 
-    if (m_in_thread_launched )
-        pthread_join( m_in_thread, NULL );
+        lo_message message = deferred.m_message;
+        osc_callback(deferred.m_path.c_str(), lo_message_get_types(message), lo_message_get_argv(message),
+                     lo_message_get_argc(message), message, deferred.m_binding);
 
-    for (int i=0; i< c_max_sequence; i++ ){
-        if ( is_active(i) ){
-            delete m_seqs[i];
-        }
+        osc_replaying = false;
+        lo_message_free(message);
     }
 
-    #ifdef USE_JACK
-    deinit_jack();
-    #endif
+    long wait = osc_deferred_messages.empty() ? 0 : osc_deferred_messages.begin()->first - now_us;
+    m_reactor.set_timer(osc_defer_timer, wait);
+}
 
-    if (global_oscport != 0) {
-        oscserver->stop();
-        delete oscserver;
-    }
+
+void perform::osc_defer_callback(int a_value, void *a_data)
+{
+    ((perform *) a_data)->osc_replay();
 }
 
-void perform::add_sequence( sequence *a_seq, int a_perf )
+
+std::string perform::osc_source_url(lo_message a_message)
 {
-    /* check for perferred */
-    if ( a_perf < c_max_sequence &&
-            is_active(a_perf) == false &&
-            a_perf >= 0 ){
+    if (osc_replaying) return osc_replay_source;
 
-        m_seqs[a_perf] = a_seq;
-        set_active(a_perf, true);
-        //a_seq->set_tag( a_perf );
+    lo_address source = lo_message_get_source(a_message);
+    if (source == NULL) return "";
 
-    } else {
+    char *url = lo_address_get_url(source);
+    std::string ret = url != NULL ? url : "";
+    free(url);
 
-        for (int i=a_perf; i< c_max_sequence; i++ ){
+    return ret;
+}
 
-            if ( is_active(i) == false ){
 
-                m_seqs[i] = a_seq;
-                set_active(i,true);
+bool perform::osc_schedule(lo_message a_message, int a_mode)
+{
+    long tick;
+    if (!osc_launch_tick(a_message, &tick)) return true;
+    if (tick < 0) return false;
 
-                //a_seq->set_tag( i  );
-                break;
-            }
+    launch l;
+    l.m_solo = a_mode == SEQ_MODE_SOLO;
+
+    for (int i = 0; i < c_mainwnd_rows * c_mainwnd_cols; i++) {
+        if (osc_selected_seqs[i] == 1) {
+            int nseq = i + m_screen_set * c_mainwnd_cols * c_mainwnd_rows;
+            l.m_seqs.push_back(make_pair(nseq, l.m_solo ? (int) SEQ_MODE_ON : a_mode));
         }
     }
+
+    add_launch(tick, &l);
+
+    return true;
 }
 
 
-void perform::set_active( int a_sequence, bool a_active )
+long perform::add_launch(long a_tick, launch *a_launch)
 {
-    if ( a_sequence < 0 || a_sequence >= c_max_sequence )
-        return;
+    m_launch_lock.lock();
+
+    if (a_tick < 0) {
+        struct timespec system_time;
+        clock_gettime(CLOCK_MONOTONIC, &system_time);
+        a_tick = get_tick_at(system_time.tv_sec * 1000000LL + system_time.tv_nsec / 1000);
+    }
+
+    if (a_tick < 0) {
+        // stopped, nothing to synchronize with
+        apply_launch(a_launch);
+    } else {
+        // applied in one go by the next cycle reaching the tick
+        m_launches.insert(make_pair(a_tick, *a_launch));
+    }
+
+    m_launch_lock.unlock();
+
+    return a_tick;
+}
+
+
+void perform::apply_launch(launch *a_launch)
+{
+    if (a_launch->m_solo) {
+        for (int i = 0; i < c_max_sequence; i++) {
+            if (is_active(i) && m_seqs[i]->get_playing()) {
+                m_seqs[i]->set_playing(false);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < a_launch->m_seqs.size(); i++) {
+
+        int nseq = a_launch->m_seqs[i].first;
+        if (nseq >= c_max_sequence || !is_active(nseq)) continue;
+
+        switch (a_launch->m_seqs[i].second) {
+            case SEQ_MODE_ON:
+                m_seqs[nseq]->set_playing(true);
+                break;
+            case SEQ_MODE_OFF:
+                m_seqs[nseq]->set_playing(false);
+                break;
+            case SEQ_MODE_TOGGLE:
+                m_seqs[nseq]->toggle_playing();
+                break;
+        }
+    }
+}
+
+
+void perform::process_launches(long a_tick)
+{
+    // the input thread is inserting, catch up on next cycle
+    if (!m_launch_lock.try_lock()) return;
+
+    while (!m_launches.empty() && m_launches.begin()->first <= a_tick) {
+        apply_launch(&m_launches.begin()->second);
+        m_launches.erase(m_launches.begin());
+    }
+
+    m_launch_lock.unlock();
+}
+
+
+void perform::osc_subscribe(const char *a_url)
+{
+    // frees the slots of the clients that went away
+    osc_expire_subscribers();
+
+    struct timespec system_time;
+    clock_gettime(CLOCK_MONOTONIC, &system_time);
+    long long now_us = system_time.tv_sec * 1000000LL + system_time.tv_nsec / 1000;
+
+    size_t i;
+    for (i = 0; i < osc_subscribers.size(); i++) {
+        if (osc_subscribers[i].m_url == a_url) break;
+    }
+
+    if (i == osc_subscribers.size()) {
+        if (osc_subscribers.size() >= (size_t) c_osc_subscribers) {
+            fprintf(stderr, "Warning, too many osc subscribers\n");
+            return;
+        }
+
+        osc_subscriber subscriber;
+        subscriber.m_url = a_url;
+        subscriber.m_address = lo_address_new_from_url(a_url);
+        if (subscriber.m_address == NULL) return;
+
+        osc_subscribers.push_back(subscriber);
+    }
+
+    // subscribing again renews the lease
+    osc_subscribers[i].m_expire_us = now_us + c_osc_subscription_us;
+
+    // full state first, the updates follow
+    osc_status(a_url, "/status/extended", SEQ_STATUS_EXT);
+
+    if (!osc_pushed_valid) {
+        transport_state transport;
+        sequence_state states[c_seqs_in_set];
+        get_play_state(&transport, m_screen_set * c_seqs_in_set, c_seqs_in_set, states);
+        osc_snapshot(&transport, states);
+    }
+
+    if (osc_push_timer < 0) {
+        osc_push_timer = m_reactor.add_timer(c_osc_push_us, &perform::osc_push_callback, this);
+    } else if (osc_subscribers.size() == 1) {
+        m_reactor.set_timer(osc_push_timer, c_osc_push_us);
+    }
+}
+
+
+void perform::osc_unsubscribe(const char *a_url)
+{
+    for (size_t i = 0; i < osc_subscribers.size(); i++) {
+        if (osc_subscribers[i].m_url == a_url) {
+            lo_address_free(osc_subscribers[i].m_address);
+            osc_subscribers.erase(osc_subscribers.begin() + i);
+            break;
+        }
+    }
+
+    if (osc_subscribers.empty() && osc_push_timer >= 0) {
+        m_reactor.set_timer(osc_push_timer, 0);
+        osc_pushed_valid = false;
+    }
+}
+
+
+void perform::osc_expire_subscribers()
+{
+    struct timespec system_time;
+    clock_gettime(CLOCK_MONOTONIC, &system_time);
+    long long now_us = system_time.tv_sec * 1000000LL + system_time.tv_nsec / 1000;
+
+    size_t i = 0;
+    while (i < osc_subscribers.size()) {
+        if (osc_subscribers[i].m_expire_us <= now_us) {
+            lo_address_free(osc_subscribers[i].m_address);
+            osc_subscribers.erase(osc_subscribers.begin() + i);
+        } else {
+            i++;
+        }
+    }
+
+    if (osc_subscribers.empty() && osc_push_timer >= 0) {
+        m_reactor.set_timer(osc_push_timer, 0);
+        osc_pushed_valid = false;
+    }
+}
+
+
+void perform::osc_snapshot(transport_state *a_transport, sequence_state *a_seqs)
+{
+    osc_pushed_valid = true;
+    osc_pushed_screenset = a_transport->m_screenset;
+    osc_pushed_running = a_transport->m_running;
+    osc_pushed_bpm = a_transport->m_bpm;
+    osc_pushed_tick = a_transport->m_tick;
+
+    for (int i = 0; i < c_seqs_in_set; i++) {
+        osc_pushed_seqs[i] = a_seqs[i];
+    }
+}
+
+
+void perform::osc_push_callback(int a_value, void *a_data)
+{
+    ((perform *) a_data)->osc_push();
+}
+
+
+// sends the subscribers what changed since the last push, or the full
+// state when the screenset or the set of active sequences changed
+void perform::osc_push()
+{
+    osc_expire_subscribers();
+    if (osc_subscribers.empty()) return;
+
+    transport_state transport;
+    sequence_state states[c_seqs_in_set];
+    get_play_state(&transport, m_screen_set * c_seqs_in_set, c_seqs_in_set, states);
+
+    bool full = !osc_pushed_valid || osc_pushed_screenset != transport.m_screenset;
+
+    std::string json = "";
+    std::string sequences = "";
+
+    if (!full) {
+        if (transport.m_running != osc_pushed_running) {
+            json += "\"playing\":" + std::to_string(transport.m_running) + ",";
+        }
+        if (transport.m_bpm != osc_pushed_bpm) {
+            json += "\"bpm\":\"" + std::to_string(transport.m_bpm) + "\",";
+        }
+        if (transport.m_tick != osc_pushed_tick) {
+            json += "\"tick\":\"" + std::to_string(transport.m_tick) + "\",";
+        }
+    }
+
+    for (int i = 0; i < c_seqs_in_set && !full; i++) {
+
+        sequence_state &state = states[i];
+        sequence_state *pushed = &osc_pushed_seqs[i];
+
+        if (state.m_active != pushed->m_active) {
+            full = true;
+            break;
+        }
+        if (!state.m_active) continue;
+
+        std::string fields = "";
+        if (state.m_playing != pushed->m_playing) {
+            fields += ",\"playing\":" + std::to_string(state.m_playing);
+        }
+        if (state.m_queued != pushed->m_queued) {
+            fields += ",\"queued\":" + std::to_string(state.m_queued);
+        }
+        if (state.m_times_played != pushed->m_times_played) {
+            fields += ",\"timesPlayed\":" + std::to_string(state.m_times_played);
+        }
+
+        if (fields != "") {
+            sequences += "{\"col\":" + std::to_string(i / c_mainwnd_rows);
+            sequences += ",\"row\":" + std::to_string(i % c_mainwnd_rows) + fields + "},";
+        }
+    }
+
+    if (full) {
+        for (size_t i = 0; i < osc_subscribers.size(); i++) {
+            osc_status(osc_subscribers[i].m_url.c_str(), "/status/extended", SEQ_STATUS_EXT);
+        }
+    } else {
+        if (sequences != "") {
+            json += "\"sequences\":[" + sequences.substr(0, sequences.size() - 1) + "],";
+        }
+        if (json != "") {
+            json = "{" + json.substr(0, json.size() - 1) + "}";
+            for (size_t i = 0; i < osc_subscribers.size(); i++) {
+                oscserver->send_json_to(osc_subscribers[i].m_address, "/status/update", json.c_str());
+            }
+        }
+    }
+
+    // what was compared, a newer cycle goes out on the next push
+    osc_snapshot(&transport, states);
+}
+
+
+// fills osc_selected_seqs from the arguments starting at a_first:
+// a column number followed by row numbers, or sequence names / patterns.
+// Both only select in the current screenset, as they always did,
+// /sequence/batch reaches the others
+bool perform::osc_select_sequences(const char *types, lo_arg ** argv, int argc, int a_first)
+{
+    for (int i = 0; i < c_mainwnd_rows * c_mainwnd_cols; i++) {
+        osc_selected_seqs[i] = 0;
+    }
+
+    if (argc < a_first + 1) return false;
+
+    if (types[a_first] == 'i') {
+        // first arg: column number
+
+        int col = argv[a_first]->i;
+        if (col < 0 || col >= c_mainwnd_cols) return false;
+
+        if (argc == a_first + 1) {
+            // select all rows in column
+            for (int i = 0; i < c_mainwnd_rows; i++) {
+                osc_selected_seqs[i + col * c_mainwnd_rows] = 1;
+            }
+        } else {
+            // select some rows in column
+            for (int i = a_first + 1; i < argc; i++) {
+                if (types[i] == 'i') {
+                    int row = argv[i]->i;
+                    if (row >= 0 && row < c_mainwnd_rows) {
+                        osc_selected_seqs[row + col * c_mainwnd_rows] = 1;
+                    }
+                }
+            }
+        }
+
+    } else if (types[a_first] == 's') {
+        // next args: sequences names / osc pattern
+
+        int first = m_screen_set * c_mainwnd_cols * c_mainwnd_rows;
+
+        for (int j = a_first; j < argc; j++) {
+            if (types[j] != 's') continue;
+
+            const vector<int> &seqs = find_sequences(&argv[j]->s);
+            for (size_t k = 0; k < seqs.size(); k++) {
+                if (seqs[k] >= first && seqs[k] < first + c_mainwnd_cols * c_mainwnd_rows) {
+                    osc_selected_seqs[seqs[k] - first] = 1;
+                }
+            }
+        }
+
+    }
+
+    return true;
+}
+
+
+void perform::osc_status( const char* address, const char* path, int command)
+{
+
+    transport_state transport;
+    sequence_state states[c_seqs_in_set];
+    get_play_state(&transport, m_screen_set * c_seqs_in_set, c_seqs_in_set, states);
+
+    std::string json = "{";
+
+    json += "\"playing\":" + std::to_string(transport.m_running) + ",";
+    json += "\"screenset\":" + std::to_string(transport.m_screenset) + ",";
+    json += "\"screensetName\":\"" + (std::string)get_screen_set_notepad(transport.m_screenset)->c_str() + "\",";
+    json += "\"tick\":\"" + std::to_string(transport.m_tick) + "\",";
+    json += "\"bpm\":\"" + std::to_string(transport.m_bpm) + "\"";
+
+    if (command == SEQ_STATUS_EXT) {
+
+        json += ",\"midiLockWaits\":[" + std::to_string(m_master_bus.get_lock_waits()) + ",";
+        json += std::to_string(m_master_bus.get_input_lock_waits()) + "]";
+        json += ",\"midiInputDropped\":" + std::to_string(get_input_dropped());
+
+        std::string controls = "";
+        for (int channel = 0; channel < 16; channel++) {
+            for (int entry = 0; entry < c_midicontrol_entries; entry++) {
+                control_action action;
+                int value;
+                if (!m_controls.get(channel, entry, &action, &value)) continue;
+                controls += "{\"channel\":" + std::to_string(channel + 1) + ",";
+                controls += entry < 128 ? "\"note\":" + std::to_string(entry) :
+                                          "\"control\":" + std::to_string(entry - 128);
+                controls += ",\"action\":\"" + (std::string)midicontrol::action_name(action) + "\",";
+                if (action == CONTROL_TOGGLE || action == CONTROL_QUEUE) {
+                    controls += "\"col\":" + std::to_string(value / c_mainwnd_rows) + ",";
+                    controls += "\"row\":" + std::to_string(value % c_mainwnd_rows) + "},";
+                } else if (action == CONTROL_SCENE) {
+                    controls += "\"row\":" + std::to_string(value) + "},";
+                } else {
+                    controls += "\"value\":" + std::to_string(value) + "},";
+                }
+            }
+        }
+        json += ",\"midiControls\":[" + controls.substr(0, controls.size() > 0 ? controls.size() - 1 : 0) + "]";
+
+        json += ",\"sequences\":[";
+        bool empty = true;
+        for (int col = 0; col < c_mainwnd_cols; col++) {
+            for (int row = 0; row < c_mainwnd_rows; row++) {
+                int slot = row + col * c_mainwnd_rows;
+                int nseq = slot + transport.m_screenset * c_seqs_in_set;
+                if (states[slot].m_active && is_active(nseq)) {
+                    empty = false;
+                    json += "{";
+                    json += "\"col\":" + std::to_string(col) + ",";
+                    json += "\"row\":" + std::to_string(row) + ",";
+                    json += "\"name\":\"" + (std::string)m_seqs[nseq]->get_name() + "\",";
+                    json += "\"time\":\"" + std::to_string(m_seqs[nseq]->get_bpm()) + "/" + std::to_string(m_seqs[nseq]->get_bw()) + "\",";
+                    json += "\"bars\":" + std::to_string(m_seqs[nseq]->get_length() * m_seqs[nseq]->get_bw() / (c_ppqn * 4 * m_seqs[nseq]->get_bpm())) + ",";
+                    json += "\"ticks\":" + std::to_string(m_seqs[nseq]->get_length()) + ",";
+                    json += "\"queued\":" + std::to_string(states[slot].m_queued) + ",";
+                    json += "\"playing\":" + std::to_string(states[slot].m_playing) + ",";
+                    json += "\"timesPlayed\":" + std::to_string(states[slot].m_times_played) + ",";
+                    json += "\"recording\":" + std::to_string(states[slot].m_recording) + ",";
+                    json += "\"events\":" + std::to_string(m_seqs[nseq]->get_event_count()) + ",";
+                    json += "\"lastTick\":" + std::to_string(m_seqs[nseq]->get_last_event_tick()) + ",";
+
+                    json += "\"noteRange\":[";
+                    if (m_seqs[nseq]->get_status_count(EVENT_NOTE_ON) > 0) {
+                        json += std::to_string(m_seqs[nseq]->get_lowest_note_event()) + ",";
+                        json += std::to_string(m_seqs[nseq]->get_highest_note_event());
+                    }
+                    json += "],";
+
+                    std::string controls;
+                    for (int cc = 0; cc < 128; cc++) {
+                        if (m_seqs[nseq]->get_control_count(cc) > 0) {
+                            controls += std::to_string(cc) + ",";
+                        }
+                    }
+                    json += "\"controls\":[" + controls.substr(0, controls.size() > 0 ? controls.size() - 1 : 0) + "],";
+
+                    std::vector<int> bars;
+                    std::string density;
+                    m_seqs[nseq]->get_bar_notes(&bars);
+                    for (size_t bar = 0; bar < bars.size(); bar++) {
+                        density += std::to_string(bars[bar]) + ",";
+                    }
+                    json += "\"density\":[" + density.substr(0, density.size() > 0 ? density.size() - 1 : 0) + "]";
+                    json += "},";
+                }
+            }
+        }
+
+        if (!empty) json = json.substr(0, json.size() - 1);
+
+        json += "]";
+
+    }
+
+    json += "}";
+
+    oscserver->send_json(address, path, json.c_str());
+
+}
+
+#ifdef USE_JACK
+void perform::init_jack()
+{
+    if ( global_with_jack_transport  && !m_jack_running)
+    {
+        m_jack_running = true;
+        //printf ( "init_jack() m_jack_running[%d]\n", m_jack_running );
+
+        do
+        {
+            // register as a jack client
+            // only to retreive transport state changes and time
+
+            m_jack_client = jack_client_open(global_client_name.c_str(), JackNullOption, NULL );
+
+            if (m_jack_client == 0)
+            {
+                printf( "JACK server is not running.\n[JACK sync disabled]\n");
+                m_jack_running = false;
+                break;
+            }
+
+            jack_on_shutdown( m_jack_client, jack_shutdown,(void *) this );
+            jack_set_process_callback(m_jack_client, jack_process_callback, (void *) this);
+
+            if (jack_activate(m_jack_client))
+            {
+                printf("Cannot register as JACK client\n");
+                m_jack_running = false;
+                break;
+            }
+        }
+        while (0);
+    }
+
+}
+
+
+void perform::deinit_jack()
+{
+    if (global_with_jack_transport) {
+
+        if (m_jack_running) {
+
+            //printf ( "deinit_jack() m_jack_running[%d]\n", m_jack_running );
+
+            m_jack_running = false;
+
+            if (jack_client_close(m_jack_client)) {
+                printf("Cannot close JACK client.\n");
+            }
+
+        }
+
+        if (!m_jack_running){
+            printf( "[JACK sync disabled]\n");
+        }
+
+    }
+}
+void jack_shutdown(void *arg)
+{
+    perform *p = (perform *) arg;
+    p->m_jack_running = false;
+
+    printf("JACK shut down.\nJACK sync Disabled.\n");
+}
+#endif
+
+void perform::clear_all()
+{
+    reset_sequences();
+
+    for (int i=0; i< c_max_sequence; i++ ){
+
+        if ( is_active(i) )
+            delete_sequence( i );
+    }
+
+    string e( "" );
+
+    for (int i=0; i<c_max_sets; i++ ){
+        set_screen_set_notepad( i, &e );
+    }
+}
+
+perform::~perform()
+{
+
+    wait_save();
+
+    // a clean exit, nothing to recover
+    m_journal_wake.lock();
+    m_journaling = false;
+    m_journal_wake.signal();
+    m_journal_wake.unlock();
+    if (m_journal_thread_launched)
+        pthread_join(m_journal_thread, NULL);
+    stop_journal();
+
+    stop();
+
+    m_reactor.stop();
+    m_outputing = false;
+    m_running = false;
+
+    m_running_lock.signal();
+    m_stopping_lock.signal();
+
+    if (m_out_thread_launched )
+        pthread_join( m_out_thread, NULL );
+
+    if (m_in_thread_launched )
+        pthread_join( m_in_thread, NULL );
+
+    // the input thread is gone, nothing more gets pushed
+    m_recording_input = false;
+    if (m_record_thread_launched) {
+        uint64_t one = 1;
+        ssize_t size = write(m_record_wake, &one, sizeof(one));
+        (void) size;
+        pthread_join(m_record_thread, NULL);
+    }
+    if (m_record_wake >= 0) close(m_record_wake);
+
+    for (int i=0; i< c_max_sequence; i++ ){
+        if ( is_active(i) ){
+            delete m_seqs[i];
+        }
+    }
+
+    #ifdef USE_JACK
+    deinit_jack();
+    #endif
+
+    for (size_t i = 0; i < osc_subscribers.size(); i++) {
+        lo_address_free(osc_subscribers[i].m_address);
+    }
+
+    multimap < long long, osc_deferred >::iterator d;
+    for (d = osc_deferred_messages.begin(); d != osc_deferred_messages.end(); d++) {
+        lo_message_free(d->second.m_message);
+    }
+
+    if (global_oscport != 0) {
+        delete oscserver;
+    }
+}
+
+void perform::add_sequence( sequence *a_seq, int a_perf )
+{
+    m_journal_lock.lock();
+
+    /* check for perferred */
+    if ( a_perf < c_max_sequence &&
+            is_active(a_perf) == false &&
+            a_perf >= 0 ){
+
+        m_seqs[a_perf] = a_seq;
+        set_active(a_perf, true);
+        //a_seq->set_tag( a_perf );
+
+    } else {
+
+        for (int i=a_perf; i< c_max_sequence; i++ ){
+
+            if ( is_active(i) == false ){
+
+                m_seqs[i] = a_seq;
+                set_active(i,true);
+
+                //a_seq->set_tag( i  );
+                break;
+            }
+        }
+    }
+
+    m_journal_changes++;
+    m_journal_lock.unlock();
+}
+
+
+void perform::set_active( int a_sequence, bool a_active )
+{
+    if ( a_sequence < 0 || a_sequence >= c_max_sequence )
+        return;
 
     //printf ("set_active %d\n", a_active );
 
@@ -532,6 +1367,27 @@ void perform::set_active( int a_sequence, bool a_active )
     }
 
     m_seqs_active[ a_sequence ] = a_active;
+    m_active_changes++;
+
+    uint64_t bit = (uint64_t) 1 << (a_sequence % 64);
+    if (a_active) {
+        m_active_bits[a_sequence / 64] |= bit;
+    } else {
+        m_active_bits[a_sequence / 64] &= ~bit;
+        m_deactivated_bits[a_sequence / 64] |= bit;
+    }
+}
+
+
+const vector<int> &perform::find_sequences( const char *a_pattern )
+{
+    long version = m_active_changes + sequence::get_name_changes();
+
+    if (!m_names.is_current(version)) {
+        m_names.build(m_seqs, m_seqs_active, c_max_sequence, version);
+    }
+
+    return m_names.find(a_pattern);
 }
 
 
@@ -615,6 +1471,58 @@ bool perform::is_running()
     return m_running;
 }
 
+// copies the transport and sequence states to m_play_state. Skipped if
+// another thread is publishing already: the state will be as fresh
+void perform::publish_play_state()
+{
+    if (!m_play_state.begin_write()) return;
+
+    transport_state transport;
+    transport.m_running = m_running;
+    transport.m_tick = m_tick;
+    transport.m_bpm = get_bpm();
+    transport.m_screenset = m_screen_set;
+    m_play_state.set_transport(&transport);
+
+    // the inactive sequences were published as such already, apart
+    // from the ones deactivated since
+    for (int w = 0; w < (c_max_sequence + 63) / 64; w++) {
+
+        uint64_t bits = m_active_bits[w] | m_deactivated_bits[w].exchange(0);
+
+        while (bits) {
+            int i = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            sequence_state state = {};
+            state.m_active = is_active(i);
+            if (state.m_active) {
+                state.m_playing = m_seqs[i]->get_playing();
+                state.m_queued = m_seqs[i]->get_queued();
+                state.m_recording = m_seqs[i]->get_recording();
+                state.m_times_played = m_seqs[i]->get_times_played();
+                state.m_last_tick = m_seqs[i]->get_last_tick();
+            }
+            m_play_state.set_sequence(i, &state);
+        }
+    }
+
+    m_play_state.end_write();
+}
+
+void perform::get_play_state(transport_state *a_transport, int a_first, int a_count, sequence_state *a_seqs)
+{
+    // no cycle publishes it while stopped
+    if (!m_running) publish_play_state();
+
+    m_play_state.read(a_transport, a_first, a_count, a_seqs);
+}
+
+void perform::get_sequence_state(int a_seq, sequence_state *a_state)
+{
+    m_play_state.get_sequence(a_seq, a_state);
+}
+
 void perform::set_bpm(double a_bpm)
 {
     if ( a_bpm < c_bpm_minimum ) a_bpm = c_bpm_minimum;
@@ -635,14 +1543,32 @@ double  perform::get_bpm( )
 
 void perform::delete_sequence( int a_num )
 {
+    // not while the journal thread reads it
+    m_journal_lock.lock();
+
     set_active(a_num, false);
 
     if ( m_seqs[a_num] != NULL ){
 
+        // the input thread can't route anything more to it
+        m_input_pass_lock.lock();
+        m_master_bus.remove_sequence_input( m_seqs[a_num] );
+        m_input_pass_lock.unlock();
+
+        // nor the record thread write in it, what it left in the
+        // ring is dropped, no newer sequence at this address gets it
+        m_record_lock.lock();
+        while (process_input()) {}
+
         m_seqs[a_num]->set_playing( false );
         delete m_seqs[a_num];
+        m_record_lock.unlock();
+
         global_is_modified = true;
     }
+
+    m_journal_changes++;
+    m_journal_lock.unlock();
 }
 
 void perform::copy_sequence( int a_num )
@@ -680,10 +1606,13 @@ void perform::move_sequence( int a_from, int a_to )
 
 void perform::new_sequence( int a_sequence )
 {
+    m_journal_lock.lock();
     m_seqs[ a_sequence ] = new sequence();
     m_seqs[ a_sequence ]->set_master_midi_bus( &m_master_bus );
     set_active(a_sequence, true);
     global_is_modified = true;
+    m_journal_changes++;
+    m_journal_lock.unlock();
 }
 
 
@@ -701,8 +1630,12 @@ void perform::print()
 
 void perform::set_screen_set_notepad( int a_screen_set, string *a_notepad )
 {
-    if ( a_screen_set < c_max_sets )
+    if ( a_screen_set < c_max_sets ) {
+        m_journal_lock.lock();
         m_screen_set_notepad[a_screen_set] = *a_notepad;
+        m_journal_changes++;
+        m_journal_lock.unlock();
+    }
 }
 
 
@@ -915,6 +1848,9 @@ void perform::launch_input_thread()
     }
     else
     m_in_thread_launched = true;
+
+    if (m_record_wake >= 0 && pthread_create(&m_record_thread, NULL, record_thread_func, this) == 0)
+        m_record_thread_launched = true;
 }
 
 
@@ -950,161 +1886,476 @@ int jack_process_callback(jack_nframes_t nframes, void* arg)
         m_mainperf->inner_stop();
     }
 
-    return 0;
+    return 0;
+}
+#endif
+
+
+void perform::output_func()
+{
+    while (m_outputing) {
+
+        //printf ("waiting for signal\n");
+
+        m_running_lock.lock();
+
+        while (!m_running) {
+
+            m_running_lock.wait();
+
+            /* if stopping, then kill thread */
+            if (!m_outputing)
+                break;
+        }
+
+        m_running_lock.unlock();
+
+        // system time
+        struct timespec system_time;
+
+        // loop timeout: 2ms
+        struct timespec ts = {
+            .tv_sec = 0,
+            .tv_nsec = 1000 * c_thread_trigger_us
+        };
+
+        long long start_time;
+        long long now_time;
+        long long playing_time;
+        long long delta_time;
+        long long exec_time;
+
+        clock_gettime(CLOCK_MONOTONIC, &system_time);
+        start_time = (system_time.tv_sec * 1e6) + (system_time.tv_nsec / 1e3);
+        playing_time = 0;
+
+        double ppqn = m_master_bus.get_ppqn();
+
+        long double current_tick = 0;
+
+        double segment_tick_us = 1e6 * 60. / m_master_bus.get_bpm() / ppqn;
+
+        m_tick_clock.reset();
+        m_tick_clock.set_segment(start_time, 0, segment_tick_us);
+
+        while (m_running) {
+
+            // delta time
+            clock_gettime(CLOCK_MONOTONIC, &system_time);
+            now_time = ((system_time.tv_sec * 1e6) + (system_time.tv_nsec / 1e3)) - start_time;
+
+            // bpm
+            double bpm = m_master_bus.get_bpm();
+
+            // delta time
+            delta_time = now_time - playing_time;
+
+            // delta time to ticks
+            double tick_duration = 1e6 * 60. / bpm / ppqn;
+            double ticks = delta_time / tick_duration;
+
+            // increment ticks
+            current_tick += ticks;
+
+            // increment playing time
+            playing_time = now_time;
+
+            // input events are stamped against this
+            if (tick_duration != segment_tick_us) {
+                m_tick_clock.set_segment(start_time + now_time, current_tick, tick_duration);
+                segment_tick_us = tick_duration;
+            }
+
+            // launches due by now, then play sequences at current tick
+            process_launches(current_tick);
+            play(current_tick);
+
+            // status readers get this cycle's state
+            publish_play_state();
+
+            // without record thread, record what came in meanwhile
+            if (!m_record_thread_launched) process_input();
+            process_controls();
+
+            m_stopping_lock.lock();
+            if (m_stopping) break;
+            m_stopping_lock.unlock();
+
+            // exec time
+            clock_gettime(CLOCK_MONOTONIC, &system_time);
+            exec_time = ((system_time.tv_sec * 1e6) + (system_time.tv_nsec / 1e3)) - start_time;
+
+            if (exec_time - now_time < c_thread_trigger_us) {
+                // adjust sleep time
+                ts.tv_nsec = 1e3 * c_thread_trigger_us - (exec_time - now_time) * 1e3;
+                nanosleep(&ts, NULL);
+            }
+        }
+
+        // don't leave events of this run in the ring
+        if (!m_record_thread_launched) process_input();
+
+        // launches scheduled against this run's ticks are void now
+        m_launch_lock.lock();
+        m_launches.clear();
+        m_launch_lock.unlock();
+
+        m_tick = -1;
+        publish_play_state();
+
+        if (m_stopping) {
+            m_running_lock.lock();
+            set_running(false);
+            m_running_lock.unlock();
+
+            reset_sequences();
+            m_stopping = false;
+            m_stopping_lock.signal();
+        } else {
+            m_master_bus.flush();
+        }
+
+        // a dump cut by the stop must not hold the note offs back
+        m_master_bus.abort_sysex();
+
+        m_stopping_lock.unlock();
+
+    }
+
+    pthread_exit(0);
+}
+
+
+void* input_thread_func(void *a_pef )
+{
+
+    /* set our performance */
+    perform *p = (perform *) a_pef;
+    assert(p);
+
+    p->input_func();
+
+    return 0;
+}
+
+
+void* record_thread_func(void *a_pef )
+{
+    perform *p = (perform *) a_pef;
+    assert(p);
+
+    p->record_func();
+
+    return 0;
+}
+
+
+void* save_thread_func(void *a_pef )
+{
+    perform *p = (perform *) a_pef;
+    assert(p);
+
+    p->save_func();
+
+    return 0;
+}
+
+
+void* journal_thread_func(void *a_pef )
+{
+    perform *p = (perform *) a_pef;
+    assert(p);
+
+    p->journal_func();
+
+    return 0;
+}
+
+
+double perform::get_tick_at(long long a_us)
+{
+    if (m_tick < 0) return -1;
+
+    return m_tick_clock.get_tick_at(a_us);
+}
+
+
+void perform::input_func()
+{
+    m_reactor.run();
+
+    pthread_exit(0);
+}
+
+
+void perform::record_func()
+{
+    uint64_t count;
+
+    while (m_recording_input) {
+
+        // sleeps until the input thread pushed something
+        if (read(m_record_wake, &count, sizeof(count)) < 0 && errno != EINTR) break;
+
+        while (process_input()) {}
+    }
+
+    pthread_exit(0);
+}
+
+
+void perform::input_callback(int a_value, void *a_data)
+{
+    ((perform *) a_data)->read_midi_input();
+}
+
+
+void perform::sysex_timer_callback(int a_value, void *a_data)
+{
+    perform *p = (perform *) a_data;
+
+    uint64_t expirations;
+    ssize_t size = read(p->m_master_bus.get_sysex_timer(), &expirations, sizeof(expirations));
+    (void) size;
+
+    p->m_master_bus.flush();
+}
+
+
+void perform::osc_input_callback(int a_value, void *a_data)
+{
+    ((perform *) a_data)->oscserver->process();
+}
+
+
+void perform::control_timer_callback(int a_value, void *a_data)
+{
+    perform *p = (perform *) a_data;
+
+    // hits arriving while stopped, and feedback
+    p->process_controls();
+    p->send_control_feedback();
+}
+
+
+void perform::start_control_timer()
+{
+    if (m_control_timer) return;
+
+    m_control_timer = m_reactor.add_timer(c_midicontrol_frame_us, &perform::control_timer_callback, this) >= 0;
 }
-#endif
 
 
-void perform::output_func()
+void perform::read_midi_input()
 {
-    while (m_outputing) {
+    event ev;
+    long long time_us;
+    bool thru = false;
+    bool pushed = false;
 
-        //printf ("waiting for signal\n");
+    m_input_pass_lock.lock();
 
-        m_running_lock.lock();
+    do {
 
-        while (!m_running) {
+        if (m_master_bus.get_midi_event(&ev, &time_us, &m_input_targets)) {
 
-            m_running_lock.wait();
+            /* control surface, not recorded nor echoed */
+            if (m_controls.dispatch(&ev)) continue;
 
-            /* if stopping, then kill thread */
-            if (!m_outputing)
-                break;
-        }
+            /* filter system wide messages, is there a sequence set? */
+            if (ev.get_status() <= EVENT_SYSEX && !m_input_targets.empty()) {
 
-        m_running_lock.unlock();
+                /* remove channel bit */
+                ev.set_status(ev.get_status());
 
-        // system time
-        struct timespec system_time;
+                /* when it was played, by the engine's clock */
+                double tick = get_tick_at(time_us - global_input_latency_us);
 
-        // loop timeout: 2ms
-        struct timespec ts = {
-            .tv_sec = 0,
-            .tv_nsec = 1000 * c_thread_trigger_us
-        };
+                if (tick >= 0) ev.set_timestamp(tick + 0.5);
 
-        long long start_time;
-        long long now_time;
-        long long playing_time;
-        long long delta_time;
-        long long exec_time;
+                for (size_t i = 0; i < m_input_targets.size(); i++) {
 
-        clock_gettime(CLOCK_MONOTONIC_RAW, &system_time);
-        start_time = (system_time.tv_sec * 1e6) + (system_time.tv_nsec / 1e3);
-        playing_time = 0;
+                    sequence *seq = m_input_targets[i];
 
-        double ppqn = m_master_bus.get_ppqn();
+                    /* thru doesn't wait for recording */
+                    if (m_master_bus.play_thru(seq, &ev)) thru = true;
 
-        long double current_tick = 0;
+                    /* the record thread dumps it */
+                    if (tick >= 0 && m_input_ring.push(&ev, seq)) pushed = true;
+                }
 
-        while (m_running) {
+            }
 
-            // delta time
-            clock_gettime(CLOCK_MONOTONIC_RAW, &system_time);
-            now_time = ((system_time.tv_sec * 1e6) + (system_time.tv_nsec / 1e3)) - start_time;
+        }
 
-            // bpm
-            double bpm = m_master_bus.get_bpm();
+    } while (m_master_bus.is_more_input());
 
-            // delta time
-            delta_time = now_time - playing_time;
+    m_input_pass_lock.unlock();
 
-            // delta time to ticks
-            double tick_duration = 1e6 * 60. / bpm / ppqn;
-            double ticks = delta_time / tick_duration;
+    if (thru) m_master_bus.flush();
 
-            // increment ticks
-            current_tick += ticks;
+    // otherwise the output thread polls the ring
+    if (pushed && m_record_thread_launched) {
+        uint64_t one = 1;
+        ssize_t size = write(m_record_wake, &one, sizeof(one));
+        (void) size;
+    }
+}
 
-            // increment playing time
-            playing_time = now_time;
 
-            // play sequences at current tick
-            play(current_tick);
+void perform::process_controls()
+{
+    if (!m_control_lock.try_lock()) return;
 
-            m_stopping_lock.lock();
-            if (m_stopping) break;
-            m_stopping_lock.unlock();
+    control_action action;
+    int value, data;
 
-            // exec time
-            clock_gettime(CLOCK_MONOTONIC_RAW, &system_time);
-            exec_time = ((system_time.tv_sec * 1e6) + (system_time.tv_nsec / 1e3)) - start_time;
+    while (m_controls.pop(&action, &value, &data)) {
 
-            if (exec_time - now_time < c_thread_trigger_us) {
-                // adjust sleep time
-                ts.tv_nsec = 1e3 * c_thread_trigger_us - (exec_time - now_time) * 1e3;
-                nanosleep(&ts, NULL);
-            }
+        int nseq = value + m_screen_set * c_seqs_in_set;
+
+        switch (action) {
+            case CONTROL_TOGGLE:
+                if (value < c_seqs_in_set && is_active(nseq)) m_seqs[nseq]->toggle_playing();
+                break;
+            case CONTROL_QUEUE:
+                if (value < c_seqs_in_set && is_active(nseq)) m_seqs[nseq]->toggle_queued();
+                break;
+            case CONTROL_SCENE:
+                launch_scene(value);
+                break;
+            case CONTROL_SCREENSET:
+                set_screenset(value);
+                break;
+            case CONTROL_BPM:
+                set_bpm(value + data);
+                break;
+            default:
+                break;
         }
+    }
 
-        m_tick = -1;
+    m_control_lock.unlock();
+}
 
-        if (m_stopping) {
-            m_running_lock.lock();
-            set_running(false);
-            m_running_lock.unlock();
 
-            reset_sequences();
-            m_stopping = false;
-            m_stopping_lock.signal();
-        } else {
-            m_master_bus.flush();
-        }
+/* queues the sequences of a row on and every other one off */
+void perform::launch_scene(int a_row)
+{
+    if (a_row >= c_mainwnd_rows) return;
 
-        m_stopping_lock.unlock();
+    for (int i = 0; i < c_seqs_in_set; i++) {
 
-    }
+        int nseq = i + m_screen_set * c_seqs_in_set;
+        if (!is_active(nseq)) continue;
 
-    pthread_exit(0);
+        /* a queued sequence changes state at its next start */
+        bool will_play = m_seqs[nseq]->get_playing() != m_seqs[nseq]->get_queued();
+
+        if (will_play != (i % c_mainwnd_rows == a_row)) m_seqs[nseq]->toggle_queued();
+    }
 }
 
 
-void* input_thread_func(void *a_pef )
+void perform::send_control_feedback()
 {
+    if (global_control_feedback_bus < 0) return;
 
-    /* set our performance */
-    perform *p = (perform *) a_pef;
-    assert(p);
+    transport_state transport;
+    sequence_state states[c_seqs_in_set];
+    get_play_state(&transport, m_screen_set * c_seqs_in_set, c_seqs_in_set, states);
 
-    p->input_func();
+    bool sent = false;
 
-    return 0;
+    for (int channel = 0; channel < 16; channel++) {
+        for (int entry = 0; entry < c_midicontrol_entries; entry++) {
+
+            control_action action;
+            int value;
+
+            if (!m_controls.get(channel, entry, &action, &value)) continue;
+
+            int state;
+
+            if (action == CONTROL_TOGGLE || action == CONTROL_QUEUE) {
+                if (value >= c_seqs_in_set || !states[value].m_active) state = c_midicontrol_led_empty;
+                else if (states[value].m_queued) state = c_midicontrol_led_queued;
+                else if (states[value].m_playing) state = c_midicontrol_led_playing;
+                else state = c_midicontrol_led_stopped;
+            } else if (action == CONTROL_SCREENSET) {
+                state = value == transport.m_screenset ? c_midicontrol_led_playing : c_midicontrol_led_stopped;
+            } else {
+                continue;
+            }
+
+            if (!m_controls.feedback_changed(channel, entry, state)) continue;
+
+            event ev;
+            ev.set_status(entry < 128 ? EVENT_NOTE_ON : EVENT_CONTROL_CHANGE);
+            ev.set_data(entry & 0x7F, state);
+            m_master_bus.play(global_control_feedback_bus, &ev, channel);
+            sent = true;
+        }
+    }
+
+    if (sent) m_master_bus.flush();
 }
 
 
-void perform::input_func()
+bool perform::process_input()
 {
     event ev;
+    sequence *seq;
 
-    while (m_inputing) {
+    m_record_lock.lock();
 
-        if (m_master_bus.poll_for_midi() > 0) {
+    m_input_batch.clear();
+    m_input_batch_seqs.clear();
 
-            do {
+    while (m_input_batch.size() < c_midiring_size && m_input_ring.pop(&ev, &seq)) {
+        m_input_batch.push_back(ev);
+        m_input_batch_seqs.push_back(seq);
+    }
 
-                if (m_master_bus.get_midi_event(&ev)) {
+    bool popped = !m_input_batch.empty();
 
-                    /* filter system wide messages */
-                    if (ev.get_status() <= EVENT_SYSEX) {
+    /* one batch per sequence, each under its own lock */
+    while (!m_input_batch.empty()) {
 
-                        /* is there a sequence set? */
-                        if (m_master_bus.is_dumping() && m_tick >= 0) {
+        seq = m_input_batch_seqs[0];
+        m_input_seq_events.clear();
 
-                            ev.set_timestamp(m_tick);
+        size_t kept = 0;
+        for (size_t i = 0; i < m_input_batch.size(); i++) {
+            if (m_input_batch_seqs[i] == seq) {
+                m_input_seq_events.push_back(m_input_batch[i]);
+            } else {
+                m_input_batch[kept] = m_input_batch[i];
+                m_input_batch_seqs[kept] = m_input_batch_seqs[i];
+                kept++;
+            }
+        }
 
-                            /* dump to it */
-                            (m_master_bus.get_sequence())->stream_event(&ev);
-                        }
+        m_input_batch.resize(kept);
+        m_input_batch_seqs.resize(kept);
 
-                    }
+        /* it may have been disarmed meanwhile, deleting it waits
+           for m_record_lock */
+        if (m_master_bus.is_dumping(seq)) {
+            seq->stream_events(&m_input_seq_events);
+        }
+    }
 
-                }
+    long dropped = m_input_ring.get_dropped();
 
-            } while (m_master_bus.is_more_input());
-        }
+    if (dropped != m_input_dropped) {
+        fprintf(stderr, "Warning, %ld MIDI input events dropped\n", dropped - m_input_dropped);
+        m_input_dropped = dropped;
     }
 
-    pthread_exit(0);
+    m_record_lock.unlock();
+
+    return popped;
 }
 
 
@@ -1136,6 +2387,7 @@ void perform::restore_playing_state()
 
 void perform::file_new()
 {
+    stop_journal();
     clear_all();
     global_filename = "";
     global_is_modified = false;
@@ -1143,11 +2395,24 @@ void perform::file_new()
 
 bool perform::file_open(std::string filename)
 {
+    stop_journal();
     clear_all();
     midifile f(filename);
     bool result = f.parse(this, 0);
     global_is_modified = !result;
-    if (result) global_filename = filename;
+    if (result) {
+        global_filename = filename;
+
+        if (global_journal) {
+            // edits left by a crash
+            int edits = journal::replay(filename, this);
+            if (edits > 0) {
+                fprintf(stderr, "Recovered %d edits from %s.journal\n", edits, filename.c_str());
+                global_is_modified = true;
+            }
+            start_journal(get_journal_base(filename), edits < 0);
+        }
+    }
     return result;
 }
 
@@ -1161,24 +2426,296 @@ bool perform::file_import(std::string filename)
 
 bool perform::file_save()
 {
-    midifile f(global_filename);
-    bool result = f.write(this, -1, -1);
-    if (result) global_is_modified = false;
-    return result;
+    return save_async(global_filename);
 }
 
 bool perform::file_saveas(std::string filename)
 {
-    midifile f(filename);
-    bool result = f.write(this, -1, -1);
-    if (result) {
-        global_filename = filename;
-        global_is_modified = false;
-    }
+    // the session only moves to filename once it's written there
+    bool result = save_async(filename) && wait_save();
+    if (result) global_filename = filename;
     return result;
 
 }
 
+// takes the snapshot here, writing and syncing happen on the save thread
+bool perform::save_async(std::string filename)
+{
+    // one save at a time, the new one supersedes a failed one
+    wait_save();
+
+    // stamps first: an edit racing the snapshot gets journaled again
+    if (global_journal) m_journal_save_base = get_journal_base(filename);
+
+    m_save_file = new midifile(filename);
+    m_save_file->fill(this, -1, -1);
+
+    // clean from this snapshot on, unless edited meanwhile or the write
+    // fails. Until it is on disk, is_saving() keeps it reported dirty
+    m_save_state = E_SAVE_RUNNING;
+    global_is_modified = false;
+
+    if (pthread_create(&m_save_thread, NULL, save_thread_func, this) != 0) {
+        save_func();
+        return m_save_state.exchange(E_SAVE_IDLE) != E_SAVE_FAILED;
+    }
+
+    m_save_thread_launched = true;
+    return true;
+}
+
+void perform::save_func()
+{
+    bool result = m_save_file->write_buffer();
+
+    delete m_save_file;
+    m_save_file = NULL;
+
+    if (!result) global_is_modified = true;
+
+    if (m_journal_save_base != NULL) {
+        // the journal restarts from what is on disk now
+        if (result) start_journal(m_journal_save_base, true);
+        else delete m_journal_save_base;
+        m_journal_save_base = NULL;
+    }
+
+    m_save_state = result ? E_SAVE_IDLE : E_SAVE_FAILED;
+}
+
+perform::journal_base *perform::get_journal_base(const string &a_session)
+{
+    journal_base *base = new journal_base;
+
+    base->m_session = a_session;
+
+    for (int i = 0; i < c_max_sequence; i++) {
+        base->m_active[i] = is_active(i);
+        base->m_stamps[i] = base->m_active[i] ? m_seqs[i]->get_edit_stamp() : 0;
+    }
+
+    base->m_bpm = get_bpm();
+
+    for (int i = 0; i < c_max_sets; i++) {
+        base->m_notes[i] = m_screen_set_notepad[i];
+    }
+
+    return base;
+}
+
+void perform::start_journal(journal_base *a_base, bool a_truncate)
+{
+    m_journal_file_lock.lock();
+
+    // a journal left for another file is obsolete
+    m_journal.close(m_journal.is_open() && m_journal.get_session() != a_base->m_session);
+
+    bool open = m_journal.open(a_base->m_session, a_truncate);
+
+    if (open) {
+        for (int i = 0; i < c_max_sequence; i++) {
+            m_journal_stamps[i] = a_base->m_stamps[i];
+            m_journal_active[i] = a_base->m_active[i];
+            m_journal_hashes[i] = 0;
+        }
+
+        m_journal_bpm = a_base->m_bpm;
+
+        for (int i = 0; i < c_max_sets; i++) {
+            m_journal_notes[i] = a_base->m_notes[i];
+        }
+
+        // the first cycle looks at everything
+        m_journal_clock = -1;
+        m_journal_changes_seen = -1;
+    }
+
+    m_journal_file_lock.unlock();
+
+    set_journal_open(open);
+
+    delete a_base;
+}
+
+void perform::stop_journal()
+{
+    m_journal_file_lock.lock();
+    m_journal.close(true);
+    m_journal_file_lock.unlock();
+
+    set_journal_open(false);
+}
+
+void perform::set_journal_open(bool a_open)
+{
+    m_journal_wake.lock();
+    m_journal_open = a_open;
+    m_journal_wake.signal();
+    m_journal_wake.unlock();
+}
+
+void perform::launch_journal_thread()
+{
+    m_journaling = true;
+
+    if (pthread_create(&m_journal_thread, NULL, journal_thread_func, this) == 0)
+        m_journal_thread_launched = true;
+}
+
+void perform::journal_func()
+{
+    m_journal_wake.lock();
+
+    while (m_journaling) {
+
+        // no journal, nothing to do until one is opened
+        if (m_journal_open) m_journal_wake.timed_wait(c_journal_period_us);
+        else m_journal_wake.wait();
+
+        if (!m_journaling) break;
+
+        m_journal_wake.unlock();
+        journal_cycle();
+        m_journal_wake.lock();
+    }
+
+    m_journal_wake.unlock();
+}
+
+// writes what changed since the last cycle. Edits only wait for the
+// copy of one sequence or of the notepads, never for the disk
+void perform::journal_cycle()
+{
+    m_journal_file_lock.lock();
+
+    // nothing edited since the last cycle: no lock taken at all
+    long clock = sequence::get_edit_clock();
+    long changes = m_journal_changes;
+    double bpm = get_bpm();
+
+    if (!m_journal.is_open() ||
+        (clock == m_journal_clock && changes == m_journal_changes_seen && bpm == m_journal_bpm)) {
+        m_journal_file_lock.unlock();
+        return;
+    }
+
+    m_journal_clock = clock;
+    m_journal_changes_seen = changes;
+
+    for (int i = 0; i < c_max_sequence; i++) {
+        journal_sequence(i);
+    }
+
+    if (bpm != m_journal_bpm) {
+        m_journal.add_bpm(bpm);
+        m_journal_bpm = bpm;
+    }
+
+    string notepads[c_max_sets];
+
+    m_journal_lock.lock();
+    for (int i = 0; i < c_max_sets; i++) {
+        notepads[i] = m_screen_set_notepad[i];
+    }
+    m_journal_lock.unlock();
+
+    for (int i = 0; i < c_max_sets; i++) {
+        if (notepads[i] != m_journal_notes[i]) {
+            m_journal.add_notes(i, notepads[i]);
+            m_journal_notes[i] = notepads[i];
+        }
+    }
+
+    if (m_journal.get_size() > c_journal_compact) journal_compact();
+    else m_journal.flush();
+
+    m_journal_file_lock.unlock();
+}
+
+// copies a_seq under m_journal_lock if it changed, the record is
+// added once the lock is released
+void perform::journal_sequence(int a_seq)
+{
+    m_journal_lock.lock();
+
+    bool active = is_active(a_seq);
+    bool changed = false;
+
+    if (active) {
+        long stamp = m_seqs[a_seq]->get_edit_stamp();
+        changed = stamp != m_journal_stamps[a_seq] || !m_journal_active[a_seq];
+
+        if (changed) {
+            m_journal_stamps[a_seq] = stamp;
+            m_journal_track.clear();
+            m_seqs[a_seq]->fill_buffer(&m_journal_track, a_seq);
+        }
+    }
+
+    m_journal_lock.unlock();
+
+    if (active) {
+
+        if (!changed) return;
+
+        // playing and queuing move the stamp, not the data
+        size_t hash = std::hash<std::string>()(std::string(m_journal_track.begin(), m_journal_track.end()));
+        if (m_journal_active[a_seq] && hash == m_journal_hashes[a_seq]) return;
+
+        m_journal.add_track(a_seq, &m_journal_track);
+        m_journal_hashes[a_seq] = hash;
+        m_journal_active[a_seq] = true;
+
+    } else if (m_journal_active[a_seq]) {
+
+        m_journal.add_delete(a_seq);
+        m_journal_active[a_seq] = false;
+    }
+}
+
+// replaces the journal with the full state of the session, copied a
+// sequence at a time like a cycle
+void perform::journal_compact()
+{
+    if (!m_journal.begin_rewrite()) return;
+
+    m_journal.add_clear();
+
+    for (int i = 0; i < c_max_sequence; i++) {
+        m_journal_active[i] = false;
+        journal_sequence(i);
+    }
+
+    m_journal.add_bpm(m_journal_bpm);
+
+    for (int i = 0; i < c_max_sets; i++) {
+        if (m_journal_notes[i] != "") m_journal.add_notes(i, m_journal_notes[i]);
+    }
+
+    m_journal.end_rewrite();
+}
+
+bool perform::is_saving()
+{
+    return m_save_state == E_SAVE_RUNNING;
+}
+
+bool perform::wait_save()
+{
+    if (m_save_thread_launched) {
+        pthread_join(m_save_thread, NULL);
+        m_save_thread_launched = false;
+    }
+
+    return !get_save_failed();
+}
+
+bool perform::get_save_failed()
+{
+    int failed = E_SAVE_FAILED;
+    return m_save_state.compare_exchange_strong(failed, E_SAVE_IDLE);
+}
+
 bool perform::file_export(std::string filename)
 {
     midifile f(filename);
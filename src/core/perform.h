@@ -18,13 +18,22 @@
 #define SEQ192_PERFORM
 
 class perform;
+class midifile;
 
 #include "globals.h"
 #include "event.h"
+#include "journal.h"
 #include "midibus.h"
 #include "midifile.h"
+#include "midicontrol.h"
+#include "midiring.h"
+#include "nameindex.h"
+#include "playstate.h"
 #include "sequence.h"
 #include "osc.h"
+#include "reactor.h"
+#include "tickclock.h"
+#include <atomic>
 #include <unistd.h>
 #include <pthread.h>
 
@@ -33,6 +42,22 @@ class perform;
 #include <jack/transport.h>
 #endif
 
+/* clients /subscribe can register */
+const int c_osc_subscribers = 8;
+
+/* changes pushed to the subscribers are coalesced over this period */
+const long c_osc_push_us = 40000;
+
+/* subscribers not renewing their /subscribe within this period are
+   dropped, so that clients gone without /unsubscribe free their slot */
+const long long c_osc_subscription_us = 60000000;
+
+enum save_state_e {
+    E_SAVE_IDLE,
+    E_SAVE_RUNNING,
+    E_SAVE_FAILED
+};
+
 /* class contains sequences that make up a live set */
 class perform
 {
@@ -51,18 +76,168 @@ class perform
 
     bool m_sequence_state[  c_max_sequence ];
 
+    /* sequence names, for osc selection. Only used by the input
+       thread, rebuilt when m_active_changes or a name changes */
+    nameindex m_names;
+    atomic < long > m_active_changes;
+
+    /* play state published for the status readers (osc, gui,
+       control feedback), see publish_play_state() */
+    playstate m_play_state;
+
+    /* one bit per sequence, maintained by set_active(), so that
+       publishing walks the active sequences only, and clears those
+       deactivated since the previous publish */
+    atomic < uint64_t > m_active_bits[ (c_max_sequence + 63) / 64 ];
+    atomic < uint64_t > m_deactivated_bits[ (c_max_sequence + 63) / 64 ];
+
+    void publish_play_state();
+
     /* our midibus */
     mastermidibus m_master_bus;
 
+    /* incoming events, from the input thread to the record thread,
+       which sleeps on m_record_wake until some are pushed, so that
+       recording never delays playback. Without eventfd the output
+       thread drains it every cycle instead */
+    midiring m_input_ring;
+    vector < event > m_input_batch;
+    vector < sequence * > m_input_batch_seqs;
+    vector < event > m_input_seq_events;
+    long m_input_dropped;
+
+    int m_record_wake;
+    atomic < bool > m_recording_input;
+
+    /* held by read_midi_input() while it holds sequences routed by
+       the bus, and by process_input() from the pop to the last write
+       in a sequence, so that delete_sequence() can wait for both and
+       purge the ring before the sequence goes */
+    smutex m_input_pass_lock;
+    smutex m_record_lock;
+    pthread_t m_record_thread;
+    bool m_record_thread_launched;
+
+    /* control surface mapping, hit by the input thread */
+    midicontrol m_controls;
+    smutex m_control_lock;
+
+    bool m_control_timer;
+
+    void launch_scene( int a_row );
+    void start_control_timer();
+
+    /* sequences started or stopped by timetagged osc bundles,
+       by tick. Filled by the input thread, applied by the output
+       thread right before playing the tick */
+    struct launch {
+        /* stop every other sequence first */
+        bool m_solo;
+
+        /* sequence number, SEQ_MODE_ON, OFF or TOGGLE */
+        vector < pair < int, int > > m_seqs;
+    };
+
+    multimap < long, launch > m_launches;
+    smutex m_launch_lock;
+
+    void process_launches( long a_tick );
+    void apply_launch( launch *a_launch );
+
+    /* queues a_launch for a_tick, or for the next cycle if a_tick is
+       -1. Applied at once while stopped. Returns the tick used */
+    long add_launch( long a_tick, launch *a_launch );
+
+    /* runs the input thread: MIDI input, OSC and control timer */
+    reactor m_reactor;
+    vector < sequence * > m_input_targets;
+
+    static void input_callback( int a_value, void *a_data );
+    static void osc_input_callback( int a_value, void *a_data );
+    static void sysex_timer_callback( int a_value, void *a_data );
+    static void control_timer_callback( int a_value, void *a_data );
+
+    void read_midi_input();
+
     /* pthread info */
     pthread_t m_out_thread;
     pthread_t m_in_thread;
     bool m_out_thread_launched;
     bool m_in_thread_launched;
 
+    /* background save: file_save() takes the snapshot on the calling
+       thread, the save thread writes it */
+    pthread_t m_save_thread;
+    bool m_save_thread_launched;
+    midifile *m_save_file;
+    atomic < int > m_save_state;
+
+    bool save_async( std::string a_filename );
+
+    /* edit journal: every period, the journal thread writes what
+       changed since the state the journal was started from */
+    struct journal_base {
+        string m_session;
+        long m_stamps[c_max_sequence];
+        bool m_active[c_max_sequence];
+        double m_bpm;
+        string m_notes[c_max_sets];
+    };
+
+    journal m_journal;
+    pthread_t m_journal_thread;
+    bool m_journal_thread_launched;
+
+    /* the journal thread sleeps on it: a period while a journal is
+       open, until one is opened otherwise */
+    condition_var m_journal_wake;
+    bool m_journaling;
+    bool m_journal_open;
+
+    /* keeps the sequences and notepads in place while the journal
+       thread copies one of them, taken around adding and deleting
+       sequences. Never held during disk writes */
+    smutex m_journal_lock;
+
+    /* guards m_journal and the state below: the journal thread
+       holds it for a cycle, writes included, opening and closing
+       the journal wait for it. Editing never takes it */
+    smutex m_journal_file_lock;
+
+    /* changes the sequence stamps don't show: sequences added or
+       deleted, notepads */
+    atomic < long > m_journal_changes;
+
+    /* edit clock, changes and tempo seen by the last cycle, a cycle
+       with none of them moved has nothing to look at */
+    long m_journal_clock;
+    long m_journal_changes_seen;
+
+    /* what the journal holds */
+    long m_journal_stamps[c_max_sequence];
+    size_t m_journal_hashes[c_max_sequence];
+    bool m_journal_active[c_max_sequence];
+    double m_journal_bpm;
+    string m_journal_notes[c_max_sets];
+    vector < unsigned char > m_journal_track;
+
+    /* base of the save in flight, applied once it is on disk */
+    journal_base *m_journal_save_base;
+
+    /* the current state, read on the thread editing the session */
+    journal_base *get_journal_base( const string &a_session );
+
+    /* (re)starts the journal from a_base, which is freed */
+    void start_journal( journal_base *a_base, bool a_truncate );
+    void stop_journal();
+    void set_journal_open( bool a_open );
+
+    void journal_sequence( int a_seq );
+    void journal_cycle();
+    void journal_compact();
+
     bool m_running;
     bool m_stopping;
-    bool m_inputing;
     bool m_outputing;
     bool m_looping;
 
@@ -70,6 +245,13 @@ class perform
 
     long m_tick;
 
+    /* where the output thread stands, written by the output thread
+       and read by the input thread */
+    tickclock m_tick_clock;
+
+    /* tick playing at a_us, -1 if stopped */
+    double get_tick_at( long long a_us );
+
     void set_running( bool a_running );
 
     string m_screen_set_notepad[c_max_sets];
@@ -143,8 +325,19 @@ class perform
 
     long get_tick( ) { return m_tick; };
 
+    /* state of the last cycle, never blocks the engine. While
+       stopped, the call publishes the current state first */
+    void get_play_state( transport_state *a_transport,
+                         int a_first, int a_count, sequence_state *a_seqs );
+    /* one sequence from the last published state */
+    void get_sequence_state( int a_seq, sequence_state *a_state );
+
     void print();
 
+    /* active sequences, from every screen set, named or matching
+       the osc pattern a_pattern */
+    const vector < int > &find_sequences( const char *a_pattern );
+
     void set_screen_set_notepad( int a_screen_set, string *a_note );
     string *get_screen_set_notepad( int a_screen_set );
 
@@ -189,9 +382,37 @@ class perform
     void output_func();
     void input_func();
 
+    /* applies the events queued by the input thread, false if
+       there were none */
+    bool process_input();
+    void record_func();
+    long get_input_dropped( ) { return m_input_ring.get_dropped(); };
+
+    /* applies the control surface hits, never waits: returns at
+       once if another thread is already at it */
+    void process_controls();
+
+    /* sends the sequence states to the control surface, meant to
+       run once per GUI frame */
+    void send_control_feedback();
+
+    reactor *get_reactor( ) { return &m_reactor; };
+
     void save_playing_state();
     void restore_playing_state();
 
+    void save_func();
+
+    void launch_journal_thread();
+    void journal_func();
+
+    /* true until the last save reached the disk */
+    bool is_saving();
+    /* waits for the save in progress, false if it failed */
+    bool wait_save();
+    /* true once after a save failed */
+    bool get_save_failed();
+
     void file_new();
     bool file_open(std::string filename);
     bool file_import(std::string filename);
@@ -206,7 +427,70 @@ class perform
                     int argc, void *data, void *user_data);
 
     int osc_selected_seqs[c_mainwnd_rows * c_mainwnd_cols];
-    void osc_status( char* address, const char* path );
+    bool osc_select_sequences(const char *types, lo_arg ** argv, int argc, int a_first);
+    void osc_status( const char* address, const char* path, int command );
+
+    /* user data of the liblo method registered for a command */
+    struct osc_binding {
+        perform *m_perform;
+        int m_command;
+    };
+
+    /* clients receiving state changes, see /subscribe */
+    struct osc_subscriber {
+        string m_url;
+        lo_address m_address;
+        /* CLOCK_MONOTONIC time the subscription lapses */
+        long long m_expire_us;
+    };
+
+    vector < osc_subscriber > osc_subscribers;
+    int osc_push_timer;
+
+    /* state last pushed to the subscribers */
+    bool osc_pushed_valid;
+    int osc_pushed_screenset;
+    bool osc_pushed_running;
+    double osc_pushed_bpm;
+    long osc_pushed_tick;
+    sequence_state osc_pushed_seqs[c_seqs_in_set];
+
+    /* schedules a_mode for the selected sequences if the message
+       has a timetag, true if it was scheduled (or dropped) */
+    bool osc_schedule(lo_message a_message, int a_mode);
+    bool osc_launch_tick(lo_message a_message, long *a_tick);
+
+    /* messages with a future timetag that aren't scheduled by tick,
+       by CLOCK_MONOTONIC time. osc_defer_timer fires when the first
+       one is due and osc_callback runs them again with osc_replaying
+       set: their timetag is ignored and replies go to the source
+       they came from */
+    struct osc_deferred {
+        string m_path;
+        lo_message m_message;
+        string m_source;
+        osc_binding *m_binding;
+    };
+
+    multimap < long long, osc_deferred > osc_deferred_messages;
+    int osc_defer_timer;
+    bool osc_replaying;
+    string osc_replay_source;
+
+    bool osc_defer(const char *a_path, const char *a_types, lo_arg **a_argv, int a_argc,
+                   lo_message a_message, osc_binding *a_binding);
+    void osc_replay();
+    static void osc_defer_callback(int a_value, void *a_data);
+
+    /* where replies to a_message go */
+    string osc_source_url(lo_message a_message);
+
+    void osc_subscribe(const char *a_url);
+    void osc_unsubscribe(const char *a_url);
+    void osc_expire_subscribers();
+    void osc_snapshot(transport_state *a_transport, sequence_state *a_seqs);
+    void osc_push();
+    static void osc_push_callback(int a_value, void *a_data);
     enum OSC_COMMANDS {
         OSC_ZERO = 0,
         SEQ_PLAY,
@@ -219,6 +503,13 @@ class perform
         SEQ_SSEQ_QUEUED,
         SEQ_STATUS,
         SEQ_STATUS_EXT,
+        SEQ_TRANSFORM,
+        SEQ_RECORD,
+        SEQ_BATCH,
+        SEQ_CONTROL_LEARN,
+        SEQ_CONTROL_CLEAR,
+        SEQ_SUBSCRIBE,
+        SEQ_UNSUBSCRIBE,
 
         SEQ_MODE_SOLO,
         SEQ_MODE_ON,
@@ -235,33 +526,10 @@ class perform
 
     };
 
-    std::map<std::string, int> osc_commands = {
-        {"/play",               SEQ_PLAY},
-        {"/stop",               SEQ_STOP},
-        {"/bpm",                SEQ_BPM},
-        {"/screenset",          SEQ_SSET},
-        {"/panic",              SEQ_PANIC},
-        {"/sequence",           SEQ_SSEQ},
-        {"/sequence/trig",      SEQ_SSEQ_AND_PLAY},
-        {"/sequence/queue",     SEQ_SSEQ_QUEUED},
-        {"/status",             SEQ_STATUS},
-        {"/status/extended",    SEQ_STATUS_EXT}
-    };
+    vector < osc_binding > osc_bindings;
 
-    std::map<std::string, int> osc_seq_modes = {
-        {"solo",                SEQ_MODE_SOLO},
-        {"on",                  SEQ_MODE_ON},
-        {"off",                 SEQ_MODE_OFF},
-        {"toggle",              SEQ_MODE_TOGGLE},
-        {"record",              SEQ_MODE_RECORD},
-        {"record_on",           SEQ_MODE_RECORD_ON},
-        {"record_off",          SEQ_MODE_RECORD_OFF},
-        {"copy",                SEQ_MODE_COPY},
-        {"cut",                 SEQ_MODE_CUT},
-        {"paste",               SEQ_MODE_PASTE},
-        {"delete",              SEQ_MODE_DELETE},
-        {"clear",               SEQ_MODE_CLEAR}
-    };
+    /* SEQ_MODE_* value of a mode string, 0 if unknown */
+    static int osc_seq_mode(const char *a_mode);
 
 
     friend class mainwid;
@@ -278,6 +546,9 @@ class perform
 /* located in perform.C */
 extern void *output_thread_func(void *a_p);
 extern void *input_thread_func(void *a_p);
+extern void *record_thread_func(void *a_p);
+extern void *save_thread_func(void *a_p);
+extern void *journal_thread_func(void *a_p);
 
 
 #ifdef USE_JACK
@@ -0,0 +1,121 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+#include "playstate.h"
+
+playstate::playstate()
+{
+    m_version = 0;
+
+    m_running = false;
+    m_tick = -1;
+    m_bpm = 0;
+    m_screenset = 0;
+
+    for ( int i = 0; i < c_max_sequence; i++ )
+        m_seqs[i] = 0;
+}
+
+/* bits 0-3: active, playing, queued, recording; 4-31: times played;
+   32-63: last tick */
+uint64_t
+playstate::pack( sequence_state *a_state )
+{
+    if ( !a_state->m_active )
+        return 0;
+
+    return 1 |
+        (uint64_t) a_state->m_playing << 1 |
+        (uint64_t) a_state->m_queued << 2 |
+        (uint64_t) a_state->m_recording << 3 |
+        (uint64_t) (a_state->m_times_played & 0xFFFFFFF) << 4 |
+        (uint64_t) (uint32_t) a_state->m_last_tick << 32;
+}
+
+void
+playstate::unpack( uint64_t a_word, sequence_state *a_state )
+{
+    a_state->m_active = a_word & 1;
+    a_state->m_playing = (a_word >> 1) & 1;
+    a_state->m_queued = (a_word >> 2) & 1;
+    a_state->m_recording = (a_word >> 3) & 1;
+    a_state->m_times_played = (a_word >> 4) & 0xFFFFFFF;
+    a_state->m_last_tick = a_word >> 32;
+}
+
+bool
+playstate::begin_write()
+{
+    if ( !m_write_lock.try_lock() )
+        return false;
+
+    m_version.fetch_add( 1, memory_order_acq_rel );
+
+    return true;
+}
+
+void
+playstate::set_transport( transport_state *a_state )
+{
+    m_running.store( a_state->m_running, memory_order_relaxed );
+    m_tick.store( a_state->m_tick, memory_order_relaxed );
+    m_bpm.store( a_state->m_bpm, memory_order_relaxed );
+    m_screenset.store( a_state->m_screenset, memory_order_relaxed );
+}
+
+void
+playstate::set_sequence( int a_seq, sequence_state *a_state )
+{
+    m_seqs[a_seq].store( pack( a_state ), memory_order_relaxed );
+}
+
+void
+playstate::end_write()
+{
+    m_version.fetch_add( 1, memory_order_release );
+
+    m_write_lock.unlock();
+}
+
+void
+playstate::read( transport_state *a_transport,
+                 int a_first, int a_count, sequence_state *a_seqs )
+{
+    unsigned version;
+
+    do {
+        version = m_version.load( memory_order_acquire );
+
+        a_transport->m_running = m_running.load( memory_order_relaxed );
+        a_transport->m_tick = m_tick.load( memory_order_relaxed );
+        a_transport->m_bpm = m_bpm.load( memory_order_relaxed );
+        a_transport->m_screenset = m_screenset.load( memory_order_relaxed );
+
+        for ( int i = 0; i < a_count; i++ )
+            unpack( m_seqs[a_first + i].load( memory_order_relaxed ), &a_seqs[i] );
+
+        atomic_thread_fence( memory_order_acquire );
+
+    } while (( version & 1 ) || version != m_version.load( memory_order_relaxed ));
+}
+
+void
+playstate::get_sequence( int a_seq, sequence_state *a_state )
+{
+    unpack( m_seqs[a_seq].load( memory_order_relaxed ), a_state );
+}
@@ -0,0 +1,92 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+#ifndef SEQ192_PLAYSTATE
+#define SEQ192_PLAYSTATE
+
+#include <atomic>
+#include <stdint.h>
+
+#include "globals.h"
+#include "mutex.h"
+
+struct transport_state
+{
+    bool m_running;
+    long m_tick;
+    double m_bpm;
+    int m_screenset;
+};
+
+struct sequence_state
+{
+    bool m_active;
+    bool m_playing;
+    bool m_queued;
+    bool m_recording;
+    long m_times_played;
+
+    /* position in the sequence */
+    long m_last_tick;
+};
+
+/* play state of the transport and of every sequence, published by
+   one writer at a time (the output thread once per cycle) and read
+   by the status consumers without locking. Each sequence is packed
+   in one word, so it is never torn; a reader wanting several of them
+   from the same cycle retries while m_version is odd or has moved. */
+class playstate
+{
+
+ private:
+
+    atomic < unsigned > m_version;
+
+    atomic < bool > m_running;
+    atomic < long > m_tick;
+    atomic < double > m_bpm;
+    atomic < int > m_screenset;
+
+    atomic < uint64_t > m_seqs[c_max_sequence];
+
+    smutex m_write_lock;
+
+    static uint64_t pack( sequence_state *a_state );
+    static void unpack( uint64_t a_word, sequence_state *a_state );
+
+ public:
+
+    playstate();
+
+    /* writer side: begin_write() returns false, without waiting,
+       if another writer is publishing */
+    bool begin_write();
+    void set_transport( transport_state *a_state );
+    void set_sequence( int a_seq, sequence_state *a_state );
+    void end_write();
+
+    /* reader side, a_count sequences from a_first, all from the
+       same cycle as the transport */
+    void read( transport_state *a_transport,
+               int a_first, int a_count, sequence_state *a_seqs );
+
+    /* a single sequence, without the retry loop */
+    void get_sequence( int a_seq, sequence_state *a_state );
+};
+
+#endif
@@ -0,0 +1,221 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+#include "reactor.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+reactor::reactor()
+{
+    m_running = true;
+
+    m_epoll = epoll_create1( EPOLL_CLOEXEC );
+    if ( m_epoll < 0 )
+        fprintf( stderr, "epoll_create1() error: %s\n", strerror( errno ));
+
+    m_wake = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK );
+    if ( m_wake < 0 )
+        fprintf( stderr, "eventfd() error: %s\n", strerror( errno ));
+    else
+        add_source( m_wake, SOURCE_WAKE, NULL, NULL );
+}
+
+reactor::~reactor()
+{
+    list < source * >::iterator i;
+
+    for ( i = m_sources.begin(); i != m_sources.end(); i++ ){
+        /* plain descriptors belong to the caller */
+        if ( (*i)->m_type != SOURCE_FD )
+            close( (*i)->m_fd );
+        delete *i;
+    }
+
+    if ( m_epoll >= 0 )
+        close( m_epoll );
+}
+
+bool
+reactor::add_source( int a_fd, source_type a_type,
+                     reactor_handler a_handler, void *a_data )
+{
+    if ( m_epoll < 0 || a_fd < 0 )
+        return false;
+
+    source *s = new source;
+    s->m_fd = a_fd;
+    s->m_type = a_type;
+    s->m_handler = a_handler;
+    s->m_data = a_data;
+
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof( ev ));
+    ev.events = EPOLLIN;
+    ev.data.ptr = s;
+
+    if ( epoll_ctl( m_epoll, EPOLL_CTL_ADD, a_fd, &ev ) < 0 ){
+        fprintf( stderr, "epoll_ctl() error: %s\n", strerror( errno ));
+        delete s;
+        return false;
+    }
+
+    m_lock.lock();
+    m_sources.push_back( s );
+    m_lock.unlock();
+
+    return true;
+}
+
+bool
+reactor::add( int a_fd, reactor_handler a_handler, void *a_data )
+{
+    return add_source( a_fd, SOURCE_FD, a_handler, a_data );
+}
+
+int
+reactor::add_timer( long a_interval_us, reactor_handler a_handler, void *a_data )
+{
+    int fd = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK );
+
+    if ( fd < 0 ){
+        fprintf( stderr, "timerfd_create() error: %s\n", strerror( errno ));
+        return -1;
+    }
+
+    if ( !set_timer( fd, a_interval_us ) ||
+         !add_source( fd, SOURCE_TIMER, a_handler, a_data )){
+        close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+bool
+reactor::set_timer( int a_timer, long a_interval_us )
+{
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = a_interval_us / 1000000;
+    spec.it_interval.tv_nsec = (a_interval_us % 1000000) * 1000;
+    spec.it_value = spec.it_interval;
+
+    if ( timerfd_settime( a_timer, 0, &spec, NULL ) < 0 ){
+        fprintf( stderr, "timerfd_settime() error: %s\n", strerror( errno ));
+        return false;
+    }
+
+    return true;
+}
+
+bool
+reactor::add_signals( const sigset_t *a_signals, reactor_handler a_handler, void *a_data )
+{
+    int fd = signalfd( -1, a_signals, SFD_CLOEXEC | SFD_NONBLOCK );
+
+    if ( fd < 0 ){
+        fprintf( stderr, "signalfd() error: %s\n", strerror( errno ));
+        return false;
+    }
+
+    if ( !add_source( fd, SOURCE_SIGNAL, a_handler, a_data )){
+        close( fd );
+        return false;
+    }
+
+    return true;
+}
+
+void
+reactor::block_signals( const sigset_t *a_signals )
+{
+    pthread_sigmask( SIG_BLOCK, a_signals, NULL );
+}
+
+void
+reactor::run()
+{
+    struct epoll_event events[c_reactor_events];
+
+    while ( m_running ){
+
+        int n = epoll_wait( m_epoll, events, c_reactor_events, -1 );
+
+        if ( n < 0 ){
+            if ( errno == EINTR )
+                continue;
+            fprintf( stderr, "epoll_wait() error: %s\n", strerror( errno ));
+            break;
+        }
+
+        for ( int i = 0; i < n && m_running; i++ ){
+
+            source *s = (source *) events[i].data.ptr;
+
+            switch ( s->m_type ){
+
+                case SOURCE_FD:
+                    s->m_handler( 0, s->m_data );
+                    break;
+
+                case SOURCE_TIMER:
+                {
+                    uint64_t expirations;
+                    if ( read( s->m_fd, &expirations, sizeof( expirations )) == sizeof( expirations ))
+                        s->m_handler( expirations, s->m_data );
+                    break;
+                }
+
+                case SOURCE_SIGNAL:
+                {
+                    struct signalfd_siginfo info;
+                    while ( read( s->m_fd, &info, sizeof( info )) == sizeof( info ))
+                        s->m_handler( info.ssi_signo, s->m_data );
+                    break;
+                }
+
+                case SOURCE_WAKE:
+                {
+                    /* m_running says it all, just empty the counter */
+                    uint64_t count;
+                    ssize_t size = read( s->m_fd, &count, sizeof( count ));
+                    (void) size;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void
+reactor::stop()
+{
+    m_running = false;
+
+    uint64_t one = 1;
+    if ( write( m_wake, &one, sizeof( one )) < 0 )
+        fprintf( stderr, "reactor: wake up failed: %s\n", strerror( errno ));
+}
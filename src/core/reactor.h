@@ -0,0 +1,103 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+
+#ifndef SEQ192_REACTOR
+#define SEQ192_REACTOR
+
+#include <atomic>
+#include <list>
+#include <signal.h>
+
+#include "globals.h"
+#include "mutex.h"
+
+/* called with the number of expirations for timers, the signal
+   number for signals and 0 for plain descriptors */
+typedef void (*reactor_handler)( int a_value, void *a_data );
+
+/* events handled per epoll_wait */
+const int c_reactor_events = 16;
+
+/* single threaded event loop over epoll: the MIDI input, the OSC
+   server, signals and timers all wake the thread running it, which
+   sleeps as long as they are quiet. Sources can be added from any
+   thread and live as long as the reactor. */
+class reactor
+{
+
+ private:
+
+    enum source_type
+    {
+        SOURCE_FD,
+        SOURCE_TIMER,
+        SOURCE_SIGNAL,
+        SOURCE_WAKE
+    };
+
+    struct source
+    {
+        int m_fd;
+        source_type m_type;
+        reactor_handler m_handler;
+        void *m_data;
+    };
+
+    int m_epoll;
+
+    /* eventfd written by stop() */
+    int m_wake;
+
+    atomic < bool > m_running;
+
+    list < source * > m_sources;
+    smutex m_lock;
+
+    bool add_source( int a_fd, source_type a_type,
+                     reactor_handler a_handler, void *a_data );
+
+ public:
+
+    reactor();
+    ~reactor();
+
+    /* a_handler runs whenever a_fd is readable, the descriptor stays
+       owned by the caller */
+    bool add( int a_fd, reactor_handler a_handler, void *a_data );
+
+    /* a_handler runs every a_interval_us, returns the timer's
+       descriptor for set_timer() or -1 */
+    int add_timer( long a_interval_us, reactor_handler a_handler, void *a_data );
+
+    /* rearms a timer, 0 disarms it */
+    bool set_timer( int a_timer, long a_interval_us );
+
+    /* a_handler runs when one of a_signals is delivered. They must
+       be blocked in every thread, see block_signals() */
+    bool add_signals( const sigset_t *a_signals, reactor_handler a_handler, void *a_data );
+
+    /* blocks a_signals in the calling thread and the threads it
+       creates afterwards, call it before starting any */
+    static void block_signals( const sigset_t *a_signals );
+
+    /* dispatches until stop() is called */
+    void run();
+    void stop();
+};
+
+#endif
@@ -18,9 +18,12 @@
 #include <stdlib.h>
 
 list < event > sequence::m_list_clipboard;
+atomic < long > sequence::m_name_changes( 0 );
+atomic < long > sequence::m_edit_clock( 0 );
 
 sequence::sequence( )
 {
+    touch();
 
     m_playing       = false;
     m_was_playing   = false;
@@ -57,6 +60,8 @@ sequence::sequence( )
 
     m_have_undo = false;
     m_have_redo = false;
+
+    update_stats();
 }
 
 void
@@ -112,6 +117,7 @@ sequence::pop_undo()
     {
         m_list_redo.push( m_list_event );
         m_list_event = m_list_undo.top();
+        update_stats();
         m_list_undo.pop();
         verify_and_link();
         unselect();
@@ -132,6 +138,7 @@ sequence::pop_redo()
     {
         m_list_undo.push( m_list_event );
         m_list_event = m_list_redo.top();
+        update_stats();
         m_list_redo.pop();
         verify_and_link();
         unselect();
@@ -179,6 +186,7 @@ sequence::set_bpm( long a_beats_per_measure )
 {
     lock();
     m_time_beats_per_measure = a_beats_per_measure;
+    update_stats();
     set_dirty_main();
     unlock();
 }
@@ -194,6 +202,7 @@ sequence::set_bw( long a_beat_width )
 {
     lock();
     m_time_beat_width = a_beat_width;
+    update_stats();
     set_dirty_main();
     unlock();
 }
@@ -217,7 +226,23 @@ sequence::add_event( const event *a_e )
     lock();
 
     m_list_event.push_front( *a_e );
+    m_stats.add( &m_list_event.front() );
     m_list_event.sort( );
+    m_index.invalidate();
+
+    set_dirty();
+
+    unlock();
+}
+
+void
+sequence::add_events( list<event> *a_list )
+{
+    lock();
+
+    /* stable, events on the same tick and rank keep their order */
+    a_list->sort( );
+    merge_events( a_list );
 
     set_dirty();
 
@@ -281,6 +306,7 @@ void
 sequence::set_resume(bool a_resume)
 {
     m_resume = a_resume;
+    touch();
 }
 
 bool
@@ -387,6 +413,8 @@ sequence::verify_and_link()
 
     lock();
 
+    m_index.invalidate();
+
     for ( i = m_list_event.begin(); i != m_list_event.end(); i++ ){
     (*i).clear_link();
         (*i).unmark();
@@ -485,6 +513,8 @@ sequence::link_new( )
 
     lock();
 
+    m_index.invalidate();
+
     on = m_list_event.begin();
 
     /* pair ons and offs */
@@ -558,7 +588,11 @@ sequence::remove(list<event>::iterator i)
         m_masterbus->play( m_bus, &(*i), m_midi_channel );
         m_playing_notes[(*i).get_note()]--;
     }
+    m_stats.remove( &(*i) );
     m_list_event.erase(i);
+    m_index.invalidate();
+
+    m_stats.set_last_tick( m_list_event.empty() ? 0 : m_list_event.back().get_timestamp() );
 }
 
 // helper function, does not lock/unlock, unsafe to call without them
@@ -581,6 +615,44 @@ sequence::remove( event* e )
 }
 
 
+// helper function, does not lock/unlock, unsafe to call without them
+void
+sequence::update_index()
+{
+    if ( !m_index.is_valid() )
+        m_index.build( &m_list_event );
+}
+
+long
+sequence::get_bar_ticks()
+{
+    if ( m_time_beats_per_measure <= 0 || m_time_beat_width <= 0 )
+        return c_ppqn * 4;
+
+    return c_ppqn * 4 * m_time_beats_per_measure / m_time_beat_width;
+}
+
+// helper function, does not lock/unlock, unsafe to call without them
+void
+sequence::update_stats()
+{
+    m_stats.build( &m_list_event, get_bar_ticks() );
+}
+
+// helper function, does not lock/unlock, unsafe to call without them
+void
+sequence::merge_events( list<event> *a_list )
+{
+    list<event>::iterator i;
+
+    for ( i = a_list->begin(); i != a_list->end(); i++ )
+        m_stats.add( &(*i) );
+
+    m_list_event.merge( *a_list );
+    m_index.invalidate();
+}
+
+
 void
 sequence::remove_marked()
 {
@@ -759,24 +831,18 @@ sequence::get_num_selected_events( unsigned char a_status,
                                    unsigned char a_cc )
 {
     int ret = 0;
-    list<event>::iterator i;
+    vector < list<event>::iterator > lane;
+    vector < list<event>::iterator >::iterator h;
 
     lock();
 
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ ){
-
-        if( (*i).get_status()    == a_status ){
-
-            unsigned char d0,d1;
-            (*i).get_data( &d0, &d1 );
+    update_index();
+    m_index.get_lane_events( a_status, a_cc, &lane );
 
-            if ( (a_status == EVENT_CONTROL_CHANGE && d0 == a_cc )
-                 || (a_status != EVENT_CONTROL_CHANGE) ){
+    for ( h = lane.begin(); h != lane.end(); h++ ){
 
-                if ( (*i).is_selected( ))
-                    ret++;
-            }
-        }
+        if ( (**h).is_selected( ))
+            ret++;
     }
 
     unlock();
@@ -831,140 +897,119 @@ sequence::select_note_events( long a_tick_s, int a_note_h,
 {
     int ret=0;
 
-    long tick_s = 0;
-    long tick_f = 0;
-
-    list<event>::iterator i;
+    vector < list<event>::iterator > hits;
+    vector < list<event>::iterator >::iterator h;
 
     lock();
 
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ ) {
+    /* only the notes whose span overlaps the box */
+    update_index();
+    m_index.find_notes( a_tick_s, a_tick_f, a_note_l, a_note_h, &hits );
 
-        if( (*i).get_note()      <= a_note_h &&
-            (*i).get_note()      >= a_note_l ) {
+    for ( h = hits.begin(); h != hits.end(); h++ ) {
 
-            if ( (*i).is_linked() ) {
-                event *ev = (*i).get_linked();
+        list<event>::iterator i = *h;
 
-                if ( (*i).is_note_off() ) {
-                    tick_s = ev->get_timestamp();
-                    tick_f = (*i).get_timestamp();
-                }
+        if ( (*i).is_linked() ) {
+            event *ev = (*i).get_linked();
 
-                if ( (*i).is_note_on() ) {
-                    tick_f = ev->get_timestamp();
-                    tick_s = (*i).get_timestamp();
+            if ( a_action == e_select ||
+                 a_action == e_select_one )
+            {
+                (*i).select( );
+                ev->select( );
+                ret++;
+                if ( a_action == e_select_one )
+                    break;
+            }
+            if ( a_action == e_is_selected )
+            {
+                if ( (*i).is_selected())
+                {
+                    ret = 1;
+                    break;
                 }
-
-                if (
-                       (    (tick_s <= tick_f) &&
-                            ((tick_s <= a_tick_f) && (tick_f >= a_tick_s)) ) ||
-                       (    (tick_s > tick_f) &&
-                        ((tick_s <= a_tick_f) || (tick_f >= a_tick_s)) ) )
+            }
+            if ( a_action == e_would_select )
+            {
+                ret = 1;
+                break;
+            }
+            if ( a_action == e_deselect )
+            {
+                ret = 0;
+                (*i).unselect( );
+                ev->unselect();
+                //break;
+            }
+            if ( a_action == e_toggle_selection &&
+                 (*i).is_note_on()) // don't toggle twice
+            {
+                if ((*i).is_selected())
                 {
-                    if ( a_action == e_select ||
-                         a_action == e_select_one )
-                    {
-                        (*i).select( );
-                        ev->select( );
-                        ret++;
-                        if ( a_action == e_select_one )
-                            break;
-                    }
-                    if ( a_action == e_is_selected )
-                    {
-                        if ( (*i).is_selected())
-                        {
-                            ret = 1;
-                            break;
-                        }
-                    }
-                    if ( a_action == e_would_select )
-                    {
-                        ret = 1;
-                        break;
-                    }
-                    if ( a_action == e_deselect )
-                    {
-                        ret = 0;
-                        (*i).unselect( );
-                        ev->unselect();
-                        //break;
-                    }
-                    if ( a_action == e_toggle_selection &&
-                         (*i).is_note_on()) // don't toggle twice
-                    {
-                        if ((*i).is_selected())
-                        {
-                            (*i).unselect( );
-                            ev->unselect();
-                            ret ++;
-                        }
-                        else
-                        {
-                            (*i).select();
-                            ev->select();
-                            ret ++;
-                        }
-                    }
-                    if ( a_action == e_remove_one )
-                    {
-                        remove( &(*i) );
-                        remove( ev );
-                        ret++;
-                        break;
-                    }
+                    (*i).unselect( );
+                    ev->unselect();
+                    ret ++;
                 }
-            } else {
-                tick_s = tick_f = (*i).get_timestamp();
-                if ( tick_s  >= a_tick_s - 16 && tick_f <= a_tick_f)
+                else
                 {
-                    if ( a_action == e_select || a_action == e_select_one )
-                    {
-                        (*i).select( );
-                        ret++;
-                        if ( a_action == e_select_one )
-                            break;
-                    }
-                    if ( a_action == e_is_selected )
-                    {
-                        if ( (*i).is_selected())
-                        {
-                            ret = 1;
-                            break;
-                        }
-                    }
-                    if ( a_action == e_would_select )
-                    {
-                        ret = 1;
-                        break;
-                    }
-                    if ( a_action == e_deselect )
-                    {
-                        ret = 0;
-                        (*i).unselect();
-                    }
-                    if ( a_action == e_toggle_selection )
-                    {
-                        if ((*i).is_selected())
-                        {
-                            (*i).unselect();
-                            ret ++;
-                        }
-                        else
-                        {
-                            (*i).select();
-                            ret ++;
-                        }
-                    }
-                    if ( a_action == e_remove_one )
-                    {
-                         remove( &(*i) );
-                         ret++;
-                         break;
-                    }
+                    (*i).select();
+                    ev->select();
+                    ret ++;
+                }
+            }
+            if ( a_action == e_remove_one )
+            {
+                remove( i );
+                remove( ev );
+                ret++;
+                break;
+            }
+        } else {
+            if ( a_action == e_select || a_action == e_select_one )
+            {
+                (*i).select( );
+                ret++;
+                if ( a_action == e_select_one )
+                    break;
+            }
+            if ( a_action == e_is_selected )
+            {
+                if ( (*i).is_selected())
+                {
+                    ret = 1;
+                    break;
+                }
+            }
+            if ( a_action == e_would_select )
+            {
+                ret = 1;
+                break;
+            }
+            if ( a_action == e_deselect )
+            {
+                ret = 0;
+                (*i).unselect();
+            }
+            if ( a_action == e_toggle_selection )
+            {
+                if ((*i).is_selected())
+                {
+                    (*i).unselect();
+                    ret ++;
+                }
+                else
+                {
+                    (*i).select();
+                    ret ++;
                 }
             }
+            if ( a_action == e_remove_one )
+            {
+                 remove( i );
+                 ret++;
+                 break;
+            }
         }
     }
 
@@ -985,6 +1030,8 @@ sequence::select_event_handle( long a_tick_s, long a_tick_f,
 
     int ret=0;
     list<event>::iterator i;
+    vector < list<event>::iterator > hits;
+    vector < list<event>::iterator >::iterator h;
 
     lock();
 
@@ -992,79 +1039,69 @@ sequence::select_event_handle( long a_tick_s, long a_tick_f,
         if( get_num_selected_events(a_status, a_cc) )
             have_selection = true;
 
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
+    update_index();
+    m_index.find_lane_events( a_status, a_cc, a_tick_s, a_tick_f, &hits );
+
+    for ( h = hits.begin(); h != hits.end(); h++ )
     {
-        if( (*i).get_status()    == a_status &&
-                (*i).get_timestamp() >= a_tick_s &&
-                (*i).get_timestamp() <= a_tick_f )
-        {
-            unsigned char d0,d1;
-            (*i).get_data( &d0, &d1 );
+        i = *h;
+
+        unsigned char d0,d1;
+        (*i).get_data( &d0, &d1 );
 
-            //printf("a_data_s [%d]: d0 [%d]: d1 [%d] \n", a_data_s, d0, d1);
+        //printf("a_data_s [%d]: d0 [%d]: d1 [%d] \n", a_data_s, d0, d1);
 
-            if ( a_status == EVENT_CONTROL_CHANGE && d0 == a_cc )
+        if ( a_status == EVENT_CONTROL_CHANGE )
+        {
+            if(d1 <= (a_data_s + a_range) && d1 >= (a_data_s - a_range) )  // is it in range
             {
-                if(d1 <= (a_data_s + a_range) && d1 >= (a_data_s - a_range) )  // is it in range
-                {
-                    unselect();
-                    (*i).select( );
-                    ret++;
-                    break;
-                }
+                unselect();
+                (*i).select( );
+                ret++;
+                break;
             }
+        }
 
-            if(a_status != EVENT_CONTROL_CHANGE )
+        if(a_status != EVENT_CONTROL_CHANGE )
+        {
+            if(a_status == EVENT_NOTE_ON || a_status == EVENT_NOTE_OFF
+               || a_status == EVENT_AFTERTOUCH || a_status == EVENT_PITCH_WHEEL )
             {
-                if(a_status == EVENT_NOTE_ON || a_status == EVENT_NOTE_OFF
-                   || a_status == EVENT_AFTERTOUCH || a_status == EVENT_PITCH_WHEEL )
+                if(d1 <= (a_data_s + a_range) && d1 >= (a_data_s -a_range) ) // is it in range
                 {
-                    if(d1 <= (a_data_s + a_range) && d1 >= (a_data_s -a_range) ) // is it in range
+                    if( have_selection)       // note on only
                     {
-                        if( have_selection)       // note on only
+                        if((*i).is_selected())
                         {
-                            if((*i).is_selected())
+                            unselect();       // all events
+                            (*i).select( );   // only this one
+                            if(ret)           // if we have a marked (unselected) one then clear it
                             {
-                                unselect();       // all events
-                                (*i).select( );   // only this one
-                                if(ret)           // if we have a marked (unselected) one then clear it
+                                for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
                                 {
-                                    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
+                                    if((*i).is_marked())
                                     {
-                                        if((*i).is_marked())
-                                        {
-                                            (*i).unmark();
-                                            break;
-                                        }
+                                        (*i).unmark();
+                                        break;
                                     }
-                                    ret--;        // clear the marked one
-                                    have_selection = false; // reset for marked flag at end
                                 }
-                                ret++;            // for the selected one
-                                break;
-                            }
-                            else                  // NOT selected note on, but in range
-                            {
-                                if(!ret)          // only mark the first one
-                                {
-                                    (*i).mark( ); // marked for hold until done
-                                    ret++;        // indicate we got one
-                                }
-                                continue;         // keep going until we find a selected one if any, or are done
+                                ret--;        // clear the marked one
+                                have_selection = false; // reset for marked flag at end
                             }
+                            ret++;            // for the selected one
+                            break;
                         }
-                        else                      // NOT note on
+                        else                  // NOT selected note on, but in range
                         {
-                            unselect();
-                            (*i).select( );
-                            ret++;
-                            break;
+                            if(!ret)          // only mark the first one
+                            {
+                                (*i).mark( ); // marked for hold until done
+                                ret++;        // indicate we got one
+                            }
+                            continue;         // keep going until we find a selected one if any, or are done
                         }
                     }
-                }
-                else
-                {
-                    if(d0 <= (a_data_s + a_range) && d0 >= (a_data_s - a_range) )  // is it in range
+                    else                      // NOT note on
                     {
                         unselect();
                         (*i).select( );
@@ -1073,6 +1110,16 @@ sequence::select_event_handle( long a_tick_s, long a_tick_f,
                     }
                 }
             }
+            else
+            {
+                if(d0 <= (a_data_s + a_range) && d0 >= (a_data_s - a_range) )  // is it in range
+                {
+                    unselect();
+                    (*i).select( );
+                    ret++;
+                    break;
+                }
+            }
         }
     }
 
@@ -1110,69 +1157,72 @@ sequence::select_events( long a_tick_s,
 			 unsigned char a_cc, select_action_e a_action)
 {
     int ret=0;
-    list<event>::iterator i;
+    vector < list<event>::iterator > hits;
+    vector < list<event>::iterator >::iterator h;
 
     lock();
 
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ ){
+    /* events at a_tick_s or up to a_event_width before it,
+       or within a_tick_s .. a_tick_f */
+    long range_s = a_tick_s;
+    long range_f = a_tick_s > a_tick_f ? a_tick_s : a_tick_f;
+    if ( a_event_width > 0 )
+        range_s -= a_event_width - 1;
 
-        if ( (*i).get_status()== a_status &&
-             (((*i).get_timestamp() == a_tick_s) ||
-             (a_tick_s > (*i).get_timestamp() && a_tick_s - (*i).get_timestamp() < a_event_width) ||
-             (a_tick_s != a_tick_f && (*i).get_timestamp() >= a_tick_s && (*i).get_timestamp() <= a_tick_f)) )
-        {
+    update_index();
+    m_index.find_lane_events( a_status, a_cc, range_s, range_f, &hits );
 
-            unsigned char d0,d1;
-            (*i).get_data( &d0, &d1 );
+    for ( h = hits.begin(); h != hits.end(); h++ ){
 
-            if ( (a_status == EVENT_CONTROL_CHANGE &&
-                        d0 == a_cc )
-                    || (a_status != EVENT_CONTROL_CHANGE) ){
+        list<event>::iterator i = *h;
 
+        if ( ((*i).get_timestamp() == a_tick_s) ||
+             (a_tick_s > (*i).get_timestamp() && a_tick_s - (*i).get_timestamp() < a_event_width) ||
+             (a_tick_s != a_tick_f && (*i).get_timestamp() >= a_tick_s && (*i).get_timestamp() <= a_tick_f) )
+        {
 
-                if ( a_action == e_select ||
-                     a_action == e_select_one )
-                {
-                    (*i).select( );
-                    ret++;
-                    if ( a_action == e_select_one )
-                        break;
-                }
-                if ( a_action == e_is_selected )
-                {
-                    if ( (*i).is_selected())
-                    {
-                        ret = 1;
-                        break;
-                    }
-                }
-                if ( a_action == e_would_select )
+            if ( a_action == e_select ||
+                 a_action == e_select_one )
+            {
+                (*i).select( );
+                ret++;
+                if ( a_action == e_select_one )
+                    break;
+            }
+            if ( a_action == e_is_selected )
+            {
+                if ( (*i).is_selected())
                 {
                     ret = 1;
                     break;
                 }
-                if ( a_action == e_toggle_selection )
-                {
-                    if ( (*i).is_selected())
-                    {
-                        (*i).unselect( );
-                    }
-                    else
-                    {
-                        (*i).select( );
-                    }
-                }
-                if ( a_action == e_deselect )
+            }
+            if ( a_action == e_would_select )
+            {
+                ret = 1;
+                break;
+            }
+            if ( a_action == e_toggle_selection )
+            {
+                if ( (*i).is_selected())
                 {
                     (*i).unselect( );
                 }
-                if ( a_action == e_remove_one )
+                else
                 {
-                     remove( &(*i) );
-                     ret++;
-                     break;
+                    (*i).select( );
                 }
             }
+            if ( a_action == e_deselect )
+            {
+                (*i).unselect( );
+            }
+            if ( a_action == e_remove_one )
+            {
+                 remove( i );
+                 ret++;
+                 break;
+            }
         }
     }
 
@@ -1510,9 +1560,17 @@ sequence::decrement_selected(unsigned char a_status, unsigned char a_control )
 void
 sequence::randomize_selected( unsigned char a_status, unsigned char a_control, int a_plus_minus )
 {
-    int random;
+    eventtransform chain;
+
+    chain.add_randomize( a_status, a_plus_minus );
+    apply_transforms( &chain, true );
+}
+
+void
+sequence::adjust_data_handle( unsigned char a_status, int a_data )
+{
     unsigned char data[2];
-    int data_item;
+    unsigned char data_item;;
     int data_idx = 0;
 
     lock();
@@ -1521,7 +1579,8 @@ sequence::randomize_selected( unsigned char a_status, unsigned char a_control, i
 
     for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
     {
-        if ( (*i).is_selected() && (*i).get_status() == a_status )
+        if ( (*i).is_selected() &&
+                (*i).get_status() == a_status )
         {
             (*i).get_data( data, data+1 );
 
@@ -1534,26 +1593,13 @@ sequence::randomize_selected( unsigned char a_status, unsigned char a_control, i
                 data_idx = 1;
             }
 
-            if ( a_status == EVENT_PROGRAM_CHANGE || a_status == EVENT_CHANNEL_PRESSURE )
+            if ( a_status == EVENT_PROGRAM_CHANGE ||
+                    a_status == EVENT_CHANNEL_PRESSURE )
             {
                 data_idx = 0;
             }
 
-            data_item = data[data_idx];
-
-            // See http://c-faq.com/lib/randrange.html
-            random = (rand() / (RAND_MAX / ((2 * a_plus_minus) + 1) + 1)) - a_plus_minus;
-
-            data_item += random;
-
-            if(data_item > 127)
-            {
-                data_item = 127;
-            }
-            else if(data_item < 0)
-            {
-                data_item = 0;
-            }
+            data_item = a_data;
 
             data[data_idx] = data_item;
 
@@ -1564,59 +1610,15 @@ sequence::randomize_selected( unsigned char a_status, unsigned char a_control, i
     unlock();
 }
 
+
 void
-sequence::adjust_data_handle( unsigned char a_status, int a_data )
+sequence::copy_selected()
 {
-    unsigned char data[2];
-    unsigned char data_item;;
-    int data_idx = 0;
+    list<event>::iterator i;
 
     lock();
 
-    list<event>::iterator i;
-
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
-    {
-        if ( (*i).is_selected() &&
-                (*i).get_status() == a_status )
-        {
-            (*i).get_data( data, data+1 );
-
-            if ( a_status == EVENT_NOTE_ON ||
-                    a_status == EVENT_NOTE_OFF ||
-                    a_status == EVENT_AFTERTOUCH ||
-                    a_status == EVENT_CONTROL_CHANGE ||
-                    a_status == EVENT_PITCH_WHEEL )
-            {
-                data_idx = 1;
-            }
-
-            if ( a_status == EVENT_PROGRAM_CHANGE ||
-                    a_status == EVENT_CHANNEL_PRESSURE )
-            {
-                data_idx = 0;
-            }
-
-            data_item = a_data;
-
-            data[data_idx] = data_item;
-
-            (*i).set_data(data[0], data[1]);
-        }
-    }
-
-    unlock();
-}
-
-
-void
-sequence::copy_selected()
-{
-    list<event>::iterator i;
-
-    lock();
-
-    m_list_clipboard.clear( );
+    m_list_clipboard.clear( );
 
     for ( i = m_list_event.begin(); i != m_list_event.end(); i++ ){
 
@@ -1664,7 +1666,7 @@ sequence::paste_selected( long a_tick, int a_note )
 	}
     }
 
-    m_list_event.merge( clipboard );
+    merge_events( &clipboard );
     m_list_event.sort();
 
     verify_and_link();
@@ -1686,28 +1688,25 @@ sequence::change_event_data_range( long a_tick_s, long a_tick_f,
 
     unsigned char d0, d1;
     list<event>::iterator i;
+    vector < list<event>::iterator > hits;
+    vector < list<event>::iterator >::iterator h;
 
     /* change only selected events, if any */
     bool have_selection = false;
     if( get_num_selected_events(a_status, a_cc) )
         have_selection = true;
 
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
-    {
-        /* initially false */
-        bool set = false;
-        (*i).get_data( &d0, &d1 );
+    /* a_tick_f may be pushed one tick further below */
+    update_index();
+    m_index.find_lane_events( a_status, a_cc, a_tick_s,
+                              a_tick_f > a_tick_s ? a_tick_f : a_tick_s + 1, &hits );
 
-        /* correct status and not CC */
-        if ( a_status != EVENT_CONTROL_CHANGE &&
-                (*i).get_status() == a_status )
-            set = true;
+    for ( h = hits.begin(); h != hits.end(); h++ )
+    {
+        i = *h;
 
-        /* correct status and correct cc */
-        if ( a_status == EVENT_CONTROL_CHANGE &&
-                (*i).get_status() == a_status &&
-                d0 == a_cc )
-            set = true;
+        bool set = true;
+        (*i).get_data( &d0, &d1 );
 
         /* in range? */
         if ( !((*i).get_timestamp() >= a_tick_s &&
@@ -1917,7 +1916,7 @@ sequence::stream_event(  event *a_ev  )
     // adjust tick
     a_ev->mod_timestamp( m_length );
 
-    if ( m_recording && a_ev->get_status() < EVENT_SYSEX ){
+    if ( m_recording && a_ev->get_status() <= EVENT_SYSEX ){
 
         // fine quantization and overwrite for events other than notes
         if (a_ev->get_status() == EVENT_AFTERTOUCH ||
@@ -1947,17 +1946,21 @@ sequence::stream_event(  event *a_ev  )
 
             a_ev->set_timestamp( a_ev->get_timestamp() + timestamp_delta );
 
-            unsigned char d0,d1;
-            a_ev->get_data( &d0, &d1 );
-            select_events(a_ev->get_timestamp(),a_ev->get_timestamp(), 3, a_ev->get_status(), d0, e_remove_one);
-        }
+            if ( eventthinner::applies( a_ev )){
 
-        add_event( a_ev );
-    }
+                m_thinned.clear();
+                m_thinner.push( a_ev, &m_thinned );
 
-    if ( m_thru )
-    {
-        put_event_on_bus( a_ev );
+                for ( size_t i = 0; i < m_thinned.size(); i++ )
+                    record_control( &m_thinned[i] );
+            }
+            else {
+                record_control( a_ev );
+            }
+        }
+        else {
+            add_event( a_ev );
+        }
     }
 
     link_new();
@@ -1974,11 +1977,54 @@ sequence::stream_event(  event *a_ev  )
 }
 
 
+/* overwrites the event of the same lane at the same tick */
+void
+sequence::record_control( event *a_ev )
+{
+    unsigned char d0,d1;
+    a_ev->get_data( &d0, &d1 );
+    select_events(a_ev->get_timestamp(),a_ev->get_timestamp(), 3, a_ev->get_status(), d0, e_remove_one);
+
+    add_event( a_ev );
+}
+
+
+void
+sequence::stream_events( vector < event > *a_events )
+{
+    lock();
+
+    for ( size_t i = 0; i < a_events->size(); i++ )
+        stream_event( &(*a_events)[i] );
+
+    unlock();
+}
+
+
 void
 sequence::set_dirty_main()
 {
     //printf( "set_dirtymp\n" );
     m_dirty_main = true;
+    touch();
+}
+
+void
+sequence::touch()
+{
+    m_edit_stamp = ++m_edit_clock;
+}
+
+long
+sequence::get_edit_stamp()
+{
+    return m_edit_stamp;
+}
+
+long
+sequence::get_edit_clock()
+{
+    return m_edit_clock;
 }
 
 void
@@ -1994,6 +2040,7 @@ sequence::set_dirty()
 {
     //printf( "set_dirty\n" );
     m_dirty_main = m_dirty_edit = true;
+    touch();
 }
 
 bool
@@ -2061,35 +2108,31 @@ sequence::play_note_off( int a_note )
 bool
 sequence::intersectNotes( long position, long position_note, long& start, long& end, long& note )
 {
+    vector < list<event>::iterator > hits;
+    vector < list<event>::iterator >::iterator h;
+
     lock();
 
-    list<event>::iterator on = m_list_event.begin();
-    list<event>::iterator off = m_list_event.begin();
-    while ( on != m_list_event.end() )
+    update_index();
+    m_index.find_notes( position, position, position_note, position_note, &hits );
+
+    for ( h = hits.begin(); h != hits.end(); h++ )
     {
-        if (position_note == (*on).get_note() &&
-            (*on).is_note_on())
+        event *on = &(**h);
+
+        if ( on->is_note_on() && on->is_linked() )
         {
-            // find next "off" event for the note
-            off = on; ++off;
-            while (off != m_list_event.end() &&
-                   ((*on).get_note() != (*off).get_note() || (*off).is_note_on()))
-            {
-                ++off;
-            }
-            if ((*on).get_note() == (*off).get_note() && (*off).is_note_off() &&
-                (*on).get_timestamp() <= position && position <= (*off).get_timestamp())
+            event *off = on->get_linked();
+
+            if (on->get_timestamp() <= position && position <= off->get_timestamp())
             {
-                start = (*on).get_timestamp();
-                end = (*off).get_timestamp();
-                note = (*on).get_note();
+                start = on->get_timestamp();
+                end = off->get_timestamp();
+                note = on->get_note();
                 unlock();
                 return true;
             }
-
-
         }
-        ++on;
     }
 
     unlock();
@@ -2099,22 +2142,24 @@ sequence::intersectNotes( long position, long position_note, long& start, long&
 bool
 sequence::intersectEvents( long posstart, long posend, long status, long& start )
 {
+    vector < list<event>::iterator > hits;
+    vector < list<event>::iterator >::iterator h;
+
     lock();
 
-    list<event>::iterator on = m_list_event.begin();
-    while ( on != m_list_event.end() )
+    /* events starting at most (posend - posstart) ticks before posstart */
+    update_index();
+    m_index.find_events( posstart - (posend - posstart), posstart, &hits );
+
+    for ( h = hits.begin(); h != hits.end(); h++ )
     {
-        //printf( "intersect   looking for:%ld  found:%ld\n", status, (*on).get_status() );
-        if (status == (*on).get_status())
+        //printf( "intersect   looking for:%ld  found:%ld\n", status, (**h).get_status() );
+        if (status == (**h).get_status())
         {
-            if ((*on).get_timestamp() <= posstart && posstart <= ((*on).get_timestamp()+(posend-posstart)))
-            {
-                start = (*on).get_timestamp();
-                unlock();
-                return true;
-            }
+            start = (**h).get_timestamp();
+            unlock();
+            return true;
         }
-        ++on;
     }
 
     unlock();
@@ -2133,46 +2178,72 @@ sequence::reset_draw_list(bool cache_events)
     unlock();
 }
 
-int
-sequence::get_lowest_note_event()
+/* copy the events of one lane for thread-safe drawing */
+void
+sequence::reset_draw_list( unsigned char a_status, unsigned char a_cc )
 {
-    lock();
+    vector < list<event>::iterator > lane;
+    vector < list<event>::iterator >::iterator h;
 
-    int ret = 127;
-    list<event>::iterator i;
+    lock();
 
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ ){
+    update_index();
+    m_index.get_lane_events( a_status, a_cc, &lane );
 
-	if ( (*i).is_note_on() || (*i).is_note_off() )
-	    if ( (*i).get_note() < ret )
-		ret = (*i).get_note();
-    }
+    m_list_event_draw.clear();
+    for ( h = lane.begin(); h != lane.end(); h++ )
+        m_list_event_draw.push_back( **h );
+    m_iterator_draw = m_list_event_draw.begin();
 
     unlock();
+}
 
-    return ret;
+int
+sequence::get_lowest_note_event()
+{
+    return m_stats.get_lowest_note();
 }
 
+int
+sequence::get_highest_note_event()
+{
+    return m_stats.get_highest_note();
+}
 
+int
+sequence::get_event_count()
+{
+    return m_stats.get_event_count();
+}
 
 int
-sequence::get_highest_note_event()
+sequence::get_status_count( unsigned char a_status )
 {
-    lock();
+    return m_stats.get_status_count( a_status );
+}
 
-    int ret = 0;
-    list<event>::iterator i;
+int
+sequence::get_control_count( unsigned char a_cc )
+{
+    return m_stats.get_control_count( a_cc );
+}
 
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ ){
+long
+sequence::get_last_event_tick()
+{
+    return m_stats.get_last_tick();
+}
 
-	if ( (*i).is_note_on() || (*i).is_note_off() )
-	    if ( (*i).get_note() > ret )
-		ret = (*i).get_note();
-    }
+/* note ons per bar, over the length of the sequence */
+void
+sequence::get_bar_notes( vector < int > *a_bars )
+{
+    lock();
 
-    unlock();
+    long bar_ticks = get_bar_ticks();
+    m_stats.get_bar_notes( a_bars, (m_length + bar_ticks - 1) / bar_ticks );
 
-    return ret;
+    unlock();
 }
 
 draw_type
@@ -2227,23 +2298,15 @@ sequence::get_next_note_event( long *a_tick_s,
 }
 
 
-bool
-sequence::get_next_event( unsigned char *a_status,
-                          unsigned char *a_cc)
+void
+sequence::get_used_lanes( vector < pair < unsigned char, unsigned char > > *a_lanes )
 {
-    unsigned char j;
+    lock();
 
-    while (  m_iterator_draw  != m_list_event_draw.end() )
-    {
-        *a_status = (*m_iterator_draw).get_status();
-        (*m_iterator_draw).get_data( a_cc, &j );
+    update_index();
+    m_index.get_lanes( a_lanes );
 
-        /* we have a good one */
-        /* update and return */
-        m_iterator_draw++;
-        return true;
-    }
-    return false;
+    unlock();
 }
 
 bool
@@ -2302,6 +2365,8 @@ sequence::remove_all()
     lock();
 
     m_list_event.clear();
+    m_index.invalidate();
+    update_stats();
 
     unlock();
 
@@ -2320,12 +2385,17 @@ sequence::operator= (const sequence& a_rhs)
 	m_midi_channel = a_rhs.m_midi_channel;
 	m_masterbus    = a_rhs.m_masterbus;
 	m_bus          = a_rhs.m_bus;
-	m_name         = a_rhs.m_name;
+	if ( m_name != a_rhs.m_name ){
+	    m_name     = a_rhs.m_name;
+	    m_name_changes++;
+	}
 	m_length       = a_rhs.m_length;
 
 	m_time_beats_per_measure = a_rhs.m_time_beats_per_measure;
 	m_time_beat_width = a_rhs.m_time_beat_width;
 
+	update_stats();
+
 	m_playing      = false;
 
 	/* no notes are playing */
@@ -2335,6 +2405,7 @@ sequence::operator= (const sequence& a_rhs)
 	/* reset */
 	zero_markers( );
 
+	touch();
     }
 
     verify_and_link();
@@ -2410,6 +2481,7 @@ sequence::set_length( long a_len )
         a_len = (c_ppqn /4);
 
     m_length = a_len;
+    touch();
 
     verify_and_link();
 
@@ -2483,6 +2555,17 @@ sequence::set_recording( bool a_r )
 {
     // called by master_midi_bus
     lock();
+
+    /* recording stops, keep the controller values held back */
+    if ( m_recording && !a_r ){
+
+        m_thinned.clear();
+        m_thinner.flush( &m_thinned );
+
+        for ( size_t i = 0; i < m_thinned.size(); i++ )
+            record_control( &m_thinned[i] );
+    }
+
     m_recording = a_r;
     set_dirty_main();
     unlock();
@@ -2524,6 +2607,10 @@ sequence::set_thru( bool a_r )
 {
     lock();
     m_thru = a_r;
+
+    if ( !m_thru && m_masterbus != NULL )
+        m_masterbus->off_thru_notes( this );
+
     unlock();
 }
 
@@ -2540,6 +2627,7 @@ void
 sequence::set_name( char *a_name )
 {
     m_name = a_name;
+    m_name_changes++;
     set_dirty_main();
 }
 
@@ -2547,9 +2635,16 @@ void
 sequence::set_name( string a_name )
 {
     m_name = a_name;
+    m_name_changes++;
     set_dirty_main();
 }
 
+long
+sequence::get_name_changes()
+{
+    return m_name_changes;
+}
+
 void
 sequence::set_midi_channel( unsigned char a_ch )
 {
@@ -2632,6 +2727,9 @@ sequence::off_playing_notes()
         }
     }
 
+    /* and those echoed from the input */
+    m_masterbus->off_thru_notes( this );
+
     m_masterbus->flush();
 
 
@@ -2653,38 +2751,23 @@ sequence::select_events( unsigned char a_status, unsigned char a_cc, bool a_inve
 {
     lock();
 
-    unsigned char d0, d1;
-    list<event>::iterator i;
-
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ ){
+    vector < list<event>::iterator > lane;
+    vector < list<event>::iterator >::iterator h;
 
-	/* initially false */
-	bool set = false;
-	(*i).get_data( &d0, &d1 );
+    update_index();
+    m_index.get_lane_events( a_status, a_cc, &lane );
 
-	/* correct status and not CC */
-	if ( a_status != EVENT_CONTROL_CHANGE &&
-	     (*i).get_status() == a_status )
-	    set = true;
-
-	/* correct status and correct cc */
-	if ( a_status == EVENT_CONTROL_CHANGE &&
-	     (*i).get_status() == a_status &&
-	     d0 == a_cc )
-	    set = true;
-
-        if ( set ){
-
-            if ( a_inverse ){
-                if ( !(*i).is_selected( ) )
-                    (*i).select( );
-                else
-                    (*i).unselect( );
+    for ( h = lane.begin(); h != lane.end(); h++ ){
 
-            }
+        if ( a_inverse ){
+            if ( !(**h).is_selected( ) )
+                (**h).select( );
             else
-                (*i).select( );
-	}
+                (**h).unselect( );
+
+        }
+        else
+            (**h).select( );
     }
 
     unlock();
@@ -2696,98 +2779,19 @@ sequence::select_events( unsigned char a_status, unsigned char a_cc, bool a_inve
 void
 sequence::transpose_notes( int a_steps )
 {
-    if(!mark_selected())
-        return;
-
-    push_undo();
-
-    event e;
-    list<event> transposed_events;
-
-    lock();
-
-    list<event>::iterator i;
-
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
-    {
-        /* is it being moved ? */
-        if ( ((*i).get_status() ==  EVENT_NOTE_ON ||
-              (*i).get_status() ==  EVENT_NOTE_OFF ||
-              (*i).get_status() ==  EVENT_AFTERTOUCH) &&
-              (*i).is_marked())
-        {
-            e = (*i);
-            e.unmark();
+    eventtransform chain;
 
-            e.set_note( e.get_note() + a_steps );
-
-            transposed_events.push_front(e);
-        }
-        else
-        {
-            (*i).unmark(); // don't transpose these and ignore
-        }
-    }
-
-    remove_marked();
-    transposed_events.sort();
-    m_list_event.merge( transposed_events);
-
-    verify_and_link();
-    unlock();
-
-    set_dirty();
+    chain.add_transpose( a_steps );
+    apply_transforms( &chain, true );
 }
 
 void
 sequence::shift_events( int a_ticks )
 {
-    if(!mark_selected())
-        return;
-
-    push_undo();
-
-    event e;
-    list<event> shifted_events;
-
-    lock();
+    eventtransform chain;
 
-    list<event>::iterator i;
-
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
-    {
-        /* is it being moved ? */
-        if ( (*i).is_marked() )
-        {
-            e = (*i);
-            e.unmark();
-
-            long timestamp = e.get_timestamp();
-            timestamp += a_ticks;
-
-            if(timestamp < 0L)
-            {
-                /* wraparound */
-                timestamp = m_length - ( (-timestamp) % m_length);
-            }
-            else
-            {
-                timestamp %= m_length;
-            }
-            //printf("in shift_notes; a_ticks=%d  timestamp=%06ld  shift_timestamp=%06ld (mlength=%ld)\n", a_ticks, e.get_timestamp(), timestamp, m_length);
-            e.set_timestamp(timestamp);
-            shifted_events.push_front(e);
-        }
-    }
-
-    remove_marked();
-    shifted_events.sort();
-    m_list_event.merge( shifted_events);
-
-    verify_and_link();
-    unlock();
-
-    set_dirty();    /* to update perfedit */
+    chain.add_shift( a_ticks );
+    apply_transforms( &chain, true );
 }
 
 /* if a note event then the status is EVENT_NOTE_ON */
@@ -2795,262 +2799,73 @@ void
 sequence::quantize_events( unsigned char a_status, unsigned char a_cc,
                           long a_snap_tick,  int a_divide, bool a_linked )
 {
-    if(!mark_selected())
-        return;
-
-    push_undo();
-
-    event e,f;
-
-    lock();
-
-    unsigned char d0, d1;
-    list<event>::iterator i;
-    list<event> quantized_events;
-
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
-    {
-        /* initially false */
-        bool set = false;
-        (*i).get_data( &d0, &d1 );
-
-        /* correct status and not CC */
-        if ( a_status != EVENT_CONTROL_CHANGE &&
-                (*i).get_status() == a_status )
-            set = true;
-
-        /* correct status and correct cc */
-        if ( a_status == EVENT_CONTROL_CHANGE &&
-                (*i).get_status() == a_status &&
-                d0 == a_cc )
-            set = true;
-
-        if( !(*i).is_marked() )
-            set = false;
-
-        if ( set )
-        {
-            /* copy event */
-            e = (*i);
-            (*i).select();
-            e.unmark();
-
-            long timestamp = e.get_timestamp();
-            long timestamp_remander = (timestamp % a_snap_tick);
-            long timestamp_delta = 0;
-
-            if ( timestamp_remander < a_snap_tick/2 )
-            {
-                timestamp_delta = - (timestamp_remander / a_divide );
-            }
-            else
-            {
-                timestamp_delta = (a_snap_tick - timestamp_remander) / a_divide;
-            }
-
-            if ((timestamp_delta + timestamp) >= m_length) // wrap around note ON to the front
-            {
-                timestamp_delta = - e.get_timestamp() ;
-            }
-
-            e.set_timestamp( e.get_timestamp() + timestamp_delta );
-            quantized_events.push_front(e);
-
-            /*
-                since the only events that are linked are notes and the status of all note calls to
-                this function are ONs, then the linked must be only EVENT_NOTE_OFF.
-            */
-
-            if ( (*i).is_linked() && a_linked ) // note OFF's only
-            {
-                f = *(*i).get_linked();
-                f.unmark();
-                (*i).get_linked()->select();
-
-                //printf("timestamp before [%ld]: timestamp_delta [%ld]: m_length [%ld]\n", f.get_timestamp(), timestamp_delta, m_length);
-
-                long adjusted_timestamp = f.get_timestamp() + timestamp_delta;
-
-                /*
-                    If adjusted_timestamp is negative then we have a note OFF that was previously wrapped before the
-                    adjustment. Since the timestamp_delta is based on the note ON which was not wrapped
-                    we need to add back the m_length for the wrapping.
-                */
-
-                if(adjusted_timestamp < 0 ) // wrapped note OFF before being adjusted
-                    adjusted_timestamp += m_length;
+    eventtransform chain;
 
-                /*
-                    If the adjusted_timestamp after is >= m_length then it will be deleted by
-                    verify_and_link() since verify_and_link() discards any notes (ON or OFF) that are
-                    >= m_length. So we must wrap if > m_length and trim if  == m_length
-                */
-
-                if(adjusted_timestamp == m_length )  // note OFF equal sequence length after adjustment so trim
-                    adjusted_timestamp -= c_note_off_margin;
-
-                if(adjusted_timestamp > m_length )  // note OFF is past end of sequence after adjustment so wrap it around
-                    adjusted_timestamp -= m_length;
-
-                f.set_timestamp( adjusted_timestamp );
-
-                quantized_events.push_front(f);
-            }
-        }
-    }
-
-    remove_marked();
-    quantized_events.sort();
-    m_list_event.merge(quantized_events);
-
-    verify_and_link();
-    unlock();
-
-    set_dirty();    /* to update perfedit */
+    chain.add_quantize( a_status, a_cc, a_snap_tick, a_divide, a_linked );
+    apply_transforms( &chain, true );
 }
 
-
-
 void
 sequence::multiply_pattern( float a_multiplier )
 {
-    long orig_length = get_length();
-    long new_length = orig_length * a_multiplier;
-
-    push_undo();
-
-    if(new_length > orig_length)
-    {
-        set_length(new_length);
-    }
+    eventtransform chain;
 
-    lock();
-
-    list<event>::iterator i;
-
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
-    {
-        long timestamp = (*i).get_timestamp();
-        if ( (*i).get_status() ==  EVENT_NOTE_OFF)
-        {
-            timestamp += c_note_off_margin;
-        }
-
-        timestamp *= a_multiplier;
-
-        if ( (*i).get_status() ==  EVENT_NOTE_OFF)
-        {
-            timestamp -= c_note_off_margin;
-        }
-
-        timestamp %= m_length;
-        //printf("in multiply_event_time; a_multiplier=%f  timestamp=%06ld  new_timestamp=%06ld (mlength=%ld)\n", a_multiplier, e.get_timestamp(), timestamp, m_length);
-        (*i).set_timestamp(timestamp);
-    }
-
-    verify_and_link();
-    unlock();
-
-    if(new_length < orig_length)
-    {
-        set_length(new_length);
-    }
-
-    set_dirty();    /* to update perfedit */
+    chain.add_scale( a_multiplier );
+    apply_transforms( &chain, false );
 }
 
 void
 sequence::reverse_pattern()
 {
+    eventtransform chain;
 
-    push_undo();
-
-    lock();
-    event e1,e2;
-
-    list<event>::iterator i;
-    list<event> reversed_events;
-
-    for ( i = m_list_event.begin(); i != m_list_event.end(); i++ )
-    {
-        /* only do for note ONs and OFFs */
-        if((*i).get_status() !=  EVENT_NOTE_ON && (*i).get_status() !=  EVENT_NOTE_OFF)
-            continue;
-
-        if((*i).is_marked())                                // we mark then as we go so don't duplicate
-            continue;
-
-        /* copy event */
-        e1 = (*i);
-
-        (*i).mark();                                        // for later deletion
+    chain.add_reverse();
+    apply_transforms( &chain, false );
+}
 
-        calulate_reverse(e1);
+bool
+sequence::apply_transforms( eventtransform *a_chain, bool a_selected )
+{
+    if ( a_chain->empty() )
+        return false;
 
-        /* get the linked event and switch it also */
+    if ( a_selected && !mark_selected() )
+        return false;
 
-        if ( (*i).is_linked() )                             // should all be linked!
-        {
-            e2 = *(*i).get_linked();
+    push_undo();
 
-            (*i).get_linked()->mark();                      // so we don't duplicate and for later remove
+    long orig_length = get_length();
+    long new_length = orig_length * a_chain->get_length_ratio();
 
-            calulate_reverse(e2);
-        }
-        else
-            continue;                                       // ignore any unlinked
+    if ( new_length > orig_length )
+        set_length( new_length );
 
-        /* reverse the velocities also */
-        unsigned char a_vel = e1.get_note_velocity();
+    list<event> moved;
 
-        e1.set_note_velocity(e2.get_note_velocity());
-        e2.set_note_velocity(a_vel);
+    lock();
 
-        reversed_events.push_front(e1);
-        reversed_events.push_front(e2);
-    }
+    /* one copy out, every step over the copies, one merge back */
+    a_chain->load( &m_list_event, a_selected );
+    a_chain->run( m_length );
+    a_chain->store( &moved );
 
     remove_marked();
-    reversed_events.sort();
-    m_list_event.merge(reversed_events);
+    merge_events( &moved );
+
     verify_and_link();
     unlock();
 
-    set_dirty();    /* to update perfedit */
-}
-
-void
-sequence::calulate_reverse(event &a_e)
-{
-    long seq_length = get_length();
-    long timestamp = a_e.get_timestamp();
-
-    /* note OFFs become note ONs & note ONs become note OFFs */
-    if ( a_e.get_status() ==  EVENT_NOTE_OFF)
-    {
-        timestamp += c_note_off_margin;     // add back the trim ending if it was a note OFF
-        a_e.set_status( EVENT_NOTE_ON);     // change it to a note ON
-    }
-    else
-        a_e.set_status( EVENT_NOTE_OFF);    // change note ONs to OFFs
+    if ( new_length < orig_length )
+        set_length( new_length );
 
-    /* calculate the reverse location */
-    double note_ratio = 1.0;
-    note_ratio -= (double)timestamp / seq_length;
-
-    timestamp = seq_length * note_ratio;    // the new location
-
-    if ( a_e.get_status() ==  EVENT_NOTE_OFF)
-    {
-        timestamp -= c_note_off_margin;     // trim the new note OFF
-    }
+    set_dirty();    /* to update perfedit */
 
-    a_e.set_timestamp(timestamp);
+    return true;
 }
 
 
-void
-addListVar( list<char> *a_list, long a_var )
+static void
+addBufferVar( vector<unsigned char> *a_buffer, long a_var )
 {
     long buffer;
     buffer = a_var & 0x7F;
@@ -3065,7 +2880,7 @@ addListVar( list<char> *a_list, long a_var )
 
     while (true){
 
-	a_list->push_front( (char) buffer & 0xFF );
+	a_buffer->push_back( (unsigned char) buffer & 0xFF );
 
 	if (buffer & 0x80)
 	    buffer >>= 8;
@@ -3074,62 +2889,69 @@ addListVar( list<char> *a_list, long a_var )
     }
 }
 
-void
-addLongList( list<char> *a_list, long a_x )
+static void
+addBufferLong( vector<unsigned char> *a_buffer, long a_x )
 {
-    a_list->push_front(  (a_x & 0xFF000000) >> 24 );
-    a_list->push_front(  (a_x & 0x00FF0000) >> 16 );
-    a_list->push_front(  (a_x & 0x0000FF00) >> 8  );
-    a_list->push_front(  (a_x & 0x000000FF)       );
+    a_buffer->push_back(  (a_x & 0xFF000000) >> 24 );
+    a_buffer->push_back(  (a_x & 0x00FF0000) >> 16 );
+    a_buffer->push_back(  (a_x & 0x0000FF00) >> 8  );
+    a_buffer->push_back(  (a_x & 0x000000FF)       );
 }
 
 
 void
-sequence::fill_list( list<char> *a_list, int a_pos )
+sequence::fill_buffer( vector<unsigned char> *a_buffer, int a_pos )
 {
 
     lock();
 
-    /* clear list */
-    *a_list = list<char>();
-
     /* sequence number */
-    addListVar( a_list, 0 );
-    a_list->push_front( 0xFF );
-    a_list->push_front( 0x00 );
-    a_list->push_front( 0x02 );
-    a_list->push_front( (a_pos & 0xFF00) >> 8 );
-    a_list->push_front( (a_pos & 0x00FF)      );
+    addBufferVar( a_buffer, 0 );
+    a_buffer->push_back( 0xFF );
+    a_buffer->push_back( 0x00 );
+    a_buffer->push_back( 0x02 );
+    a_buffer->push_back( (a_pos & 0xFF00) >> 8 );
+    a_buffer->push_back( (a_pos & 0x00FF)      );
 
     /* name */
-    addListVar( a_list, 0 );
-    a_list->push_front( 0xFF );
-    a_list->push_front( 0x03 );
+    addBufferVar( a_buffer, 0 );
+    a_buffer->push_back( 0xFF );
+    a_buffer->push_back( 0x03 );
 
     int length =  m_name.length();
     if ( length > 0x7F ) length = 0x7f;
-    a_list->push_front( length );
+    a_buffer->push_back( length );
 
-    for ( int i=0; i< length; i++ )
-	a_list->push_front( m_name.c_str()[i] );
+    a_buffer->insert( a_buffer->end(), m_name.c_str(), m_name.c_str() + length );
 
     long timestamp = 0, delta_time = 0, prev_timestamp = 0;
     list<event>::iterator i;
 
     for ( i = m_list_event.begin(); i != m_list_event.end(); i++ ){
 
-	event e = (*i);
+	event &e = (*i);
 	timestamp = e.get_timestamp();
 	delta_time = timestamp - prev_timestamp;
 	prev_timestamp = timestamp;
 
 	/* encode delta_time */
-	addListVar( a_list, delta_time );
+	addBufferVar( a_buffer, delta_time );
 
 	/* now that the timestamp is encoded, do the status and
 	   data */
 
-	a_list->push_front( e.m_status | m_midi_channel );
+	/* sysex: F0, length, then the data following F0 */
+	if ( e.m_status == EVENT_SYSEX ){
+
+            a_buffer->push_back( EVENT_SYSEX );
+            addBufferVar( a_buffer, e.get_size() - 1 );
+
+            a_buffer->insert( a_buffer->end(), e.get_sysex() + 1, e.get_sysex() + e.get_size() );
+
+            continue;
+	}
+
+	a_buffer->push_back( e.m_status | m_midi_channel );
 
 	switch( e.m_status & 0xF0 ){
 
@@ -3139,8 +2961,8 @@ sequence::fill_list( list<char> *a_list, int a_pos )
             case 0xB0:
             case 0xE0:
 
-                a_list->push_front(  e.m_data[0] );
-                a_list->push_front(  e.m_data[1] );
+                a_buffer->push_back(  e.m_data[0] );
+                a_buffer->push_back(  e.m_data[1] );
 
                 //printf ( "- d[%2X %2X]\n" , e.m_data[0], e.m_data[1] );
 
@@ -3149,7 +2971,7 @@ sequence::fill_list( list<char> *a_list, int a_pos )
             case 0xC0:
             case 0xD0:
 
-                a_list->push_front(  e.m_data[0] );
+                a_buffer->push_back(  e.m_data[0] );
 
                 //printf ( "- d[%2X]\n" , e.m_data[0] );
 
@@ -3161,54 +2983,54 @@ sequence::fill_list( list<char> *a_list, int a_pos )
     }
 
     /* bus */
-    addListVar( a_list, 0 );
-    a_list->push_front( 0xFF );
-    a_list->push_front( 0x7F );
-    a_list->push_front( 0x05 );
-    addLongList( a_list, c_midibus );
-    a_list->push_front( m_bus  );
+    addBufferVar( a_buffer, 0 );
+    a_buffer->push_back( 0xFF );
+    a_buffer->push_back( 0x7F );
+    a_buffer->push_back( 0x05 );
+    addBufferLong( a_buffer, c_midibus );
+    a_buffer->push_back( m_bus  );
 
     /* timesig */
-    addListVar( a_list, 0 );
-    a_list->push_front( 0xFF );
-    a_list->push_front( 0x7F );
-    a_list->push_front( 0x06 );
-    addLongList( a_list, c_timesig );
-    a_list->push_front( m_time_beats_per_measure  );
-    a_list->push_front( m_time_beat_width  );
+    addBufferVar( a_buffer, 0 );
+    a_buffer->push_back( 0xFF );
+    a_buffer->push_back( 0x7F );
+    a_buffer->push_back( 0x06 );
+    addBufferLong( a_buffer, c_timesig );
+    a_buffer->push_back( m_time_beats_per_measure  );
+    a_buffer->push_back( m_time_beat_width  );
 
     /* channel */
-    addListVar( a_list, 0 );
-    a_list->push_front( 0xFF );
-    a_list->push_front( 0x7F );
-    a_list->push_front( 0x05 );
-    addLongList( a_list, c_midich );
-    a_list->push_front( m_midi_channel );
+    addBufferVar( a_buffer, 0 );
+    a_buffer->push_back( 0xFF );
+    a_buffer->push_back( 0x7F );
+    a_buffer->push_back( 0x05 );
+    addBufferLong( a_buffer, c_midich );
+    a_buffer->push_back( m_midi_channel );
 
     /* resume */
-    addListVar( a_list, 0 );
-    a_list->push_front( 0xFF );
-    a_list->push_front( 0x7F );
-    a_list->push_front( 0x05 );
-    addLongList( a_list, c_resume );
-    a_list->push_front( m_resume );
+    addBufferVar( a_buffer, 0 );
+    a_buffer->push_back( 0xFF );
+    a_buffer->push_back( 0x7F );
+    a_buffer->push_back( 0x05 );
+    addBufferLong( a_buffer, c_resume );
+    a_buffer->push_back( m_resume );
 
     /* meta */
-    addListVar( a_list, 0 );
-    a_list->push_front( 0xFF );
-    a_list->push_front( 0x7F );
-    a_list->push_front( 0x05 );
-    addLongList( a_list, c_alt_cc );
-    a_list->push_front( m_alt_cc + 1); // can't write -1 here
+    addBufferVar( a_buffer, 0 );
+    a_buffer->push_back( 0xFF );
+    a_buffer->push_back( 0x7F );
+    a_buffer->push_back( 0x05 );
+    addBufferLong( a_buffer, c_alt_cc );
+    a_buffer->push_back( m_alt_cc + 1); // can't write -1 here
 
 
     delta_time = m_length - prev_timestamp;
 
     /* meta track end */
-    addListVar( a_list, delta_time );
-    a_list->push_front( 0xFF );
-    a_list->push_front( 0x2F );
-    a_list->push_front( 0x00 );
+    addBufferVar( a_buffer, delta_time );
+    a_buffer->push_back( 0xFF );
+    a_buffer->push_back( 0x2F );
+    a_buffer->push_back( 0x00 );
 
     unlock();
 }
@@ -19,11 +19,16 @@
 
 class sequence;
 
+#include <atomic>
 #include <string>
 #include <list>
 #include <stack>
 
 #include "event.h"
+#include "eventindex.h"
+#include "eventstats.h"
+#include "eventthinner.h"
+#include "eventtransform.h"
 #include "midibus.h"
 #include "globals.h"
 #include "mutex.h"
@@ -46,11 +51,31 @@ class sequence
     list < event > m_list_event_draw;
     static list < event > m_list_clipboard;
 
+    /* bumped on every rename, see nameindex */
+    static atomic < long > m_name_changes;
+
+    /* set from m_edit_clock on every change, so that a stamp is
+       never shared by two sequences. See the perform journal */
+    static atomic < long > m_edit_clock;
+    atomic < long > m_edit_stamp;
+
+    void touch();
+
     list < event > m_list_undo_hold; // seqdata
 
     stack < list < event > >m_list_undo;
     stack < list < event > >m_list_redo;
 
+    /* lookup tables over m_list_event for hit-testing */
+    eventindex m_index;
+
+    /* note range, event counts, ... of m_list_event */
+    eventstats m_stats;
+
+    /* controller thinning while recording */
+    eventthinner m_thinner;
+    vector < event > m_thinned;
+
     /* markers */
     list < event >::iterator m_iterator_play;
     list < event >::iterator m_iterator_draw;
@@ -123,6 +148,21 @@ class sequence
     void lock ();
     void unlock ();
 
+    /* rebuilds m_index if events changed since last query */
+    void update_index();
+
+    /* length of a bar in ticks */
+    long get_bar_ticks();
+
+    /* recounts m_stats from scratch */
+    void update_stats();
+
+    /* moves the events of a sorted list into m_list_event */
+    void merge_events( list<event> *a_list );
+
+    /* adds a recorded controller event */
+    void record_control( event *a_ev );
+
     long adjust_offset( long a_offset );
     void remove( list<event>::iterator i );
     void remove( event* e );
@@ -166,6 +206,12 @@ class sequence
 
     /* returns string of name */
     const char *get_name();
+    static long get_name_changes();
+
+    long get_edit_stamp();
+
+    /* moves on every change of any sequence */
+    static long get_edit_clock();
 
     /* length in ticks */
     void set_length (long a_len);
@@ -199,7 +245,7 @@ class sequence
     void set_thru (bool);
     bool get_thru ();
 
-    void set_alt_cc(int cc){m_alt_cc=cc;};
+    void set_alt_cc(int cc){m_alt_cc=cc; touch();};
     int get_alt_cc(){return m_alt_cc;};
 
     /* singals that a redraw is needed from recording */
@@ -230,6 +276,10 @@ class sequence
     /* adds event to internal list */
     void add_event (const event * a_e);
 
+    /* moves a_list, in any order, into the internal list with a
+       single sort. Used when loading a whole track */
+    void add_events (list < event > *a_list);
+
     bool intersectNotes( long position, long position_note, long& start, long& end, long& note );
     bool intersectEvents( long posstart, long posend, long status, long& start );
 
@@ -299,6 +349,9 @@ class sequence
 
     void stream_event (event * a_ev);
 
+    /* streams a batch of incoming events under a single lock */
+    void stream_events (vector < event > *a_events);
+
     /* changes velocities in a ramping way from vel_s to vel_f  */
     void change_event_data_range (long a_tick_s, long a_tick_f,
 				  unsigned char a_status,
@@ -355,6 +408,9 @@ class sequence
     /* copy event list for thread-safe drawing */
     void reset_draw_list(bool cache_events = true);
 
+    /* same, copying only the events of one status / controller lane */
+    void reset_draw_list(unsigned char a_status, unsigned char a_cc);
+
     /* each call seqdata( sequence *a_seq, int a_scale );fills the passed refrences with a
        events elements, and returns true.  When it
        has no more events, returns a false */
@@ -366,17 +422,26 @@ class sequence
     int get_lowest_note_event ();
     int get_highest_note_event ();
 
+    /* event statistics, none of these rescan the events */
+    int get_event_count ();
+    int get_status_count (unsigned char a_status);
+    int get_control_count (unsigned char a_cc);
+    long get_last_event_tick ();
+    void get_bar_notes (vector < int > *a_bars);
+
     bool get_next_event (unsigned char a_status,
                          unsigned char a_cc,
                          long *a_tick,
                          unsigned char *a_D0,
                          unsigned char *a_D1, bool * a_selected, int type = ALL_EVENTS);
 
-    bool get_next_event (unsigned char *a_status, unsigned char *a_cc);
+    /* fills a_lanes with the status / controller pairs in use */
+    void get_used_lanes (vector < pair < unsigned char, unsigned char > > *a_lanes);
 
     sequence & operator= (const sequence & a_rhs);
 
-    void fill_list (list < char >*a_list, int a_pos);
+    /* appends the track data (without the MTrk header) to a_buffer */
+    void fill_buffer (vector < unsigned char > *a_buffer, int a_pos);
 
     void select_events (unsigned char a_status, unsigned char a_cc,
 			bool a_inverse = false);
@@ -387,7 +452,10 @@ class sequence
     void shift_events (int a_ticks);  // move selected events later/earlier in time
     void multiply_pattern( float a_multiplier );
     void reverse_pattern();
-    void calulate_reverse(event &a_e);
+
+    /* runs a chain of transforms over the selected events, or over
+       all of them; returns false if there was nothing to do */
+    bool apply_transforms (eventtransform *a_chain, bool a_selected);
 };
 
 #endif
@@ -0,0 +1,85 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "tickclock.h"
+
+tickclock::tickclock()
+{
+    m_version = 0;
+    reset();
+}
+
+void
+tickclock::reset()
+{
+    m_version++;
+
+    m_current.m_us = 0;
+    m_current.m_tick = 0;
+    m_current.m_tick_us = 0;
+    m_previous.m_us = 0;
+    m_previous.m_tick = 0;
+    m_previous.m_tick_us = 0;
+
+    m_version++;
+}
+
+void
+tickclock::set_segment( long long a_us, double a_tick, double a_tick_us )
+{
+    m_version++;
+
+    m_previous.m_us = m_current.m_us.load();
+    m_previous.m_tick = m_current.m_tick.load();
+    m_previous.m_tick_us = m_current.m_tick_us.load();
+
+    m_current.m_us = a_us;
+    m_current.m_tick = a_tick;
+    m_current.m_tick_us = a_tick_us;
+
+    m_version++;
+}
+
+double
+tickclock::get_tick_at( long long a_us )
+{
+    unsigned version;
+    long long us;
+    double tick, tick_us;
+
+    do {
+        version = m_version;
+
+        us = m_current.m_us;
+        tick = m_current.m_tick;
+        tick_us = m_current.m_tick_us;
+
+        /* played before the tempo change */
+        if ( a_us < us && m_previous.m_tick_us > 0 ){
+            us = m_previous.m_us;
+            tick = m_previous.m_tick;
+            tick_us = m_previous.m_tick_us;
+        }
+
+    } while ( (version & 1) || version != m_version );
+
+    if ( tick_us <= 0 )
+        return -1;
+
+    tick += (a_us - us) / tick_us;
+
+    return tick < 0 ? 0 : tick;
+}
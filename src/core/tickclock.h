@@ -0,0 +1,62 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#ifndef SEQ192_TICKCLOCK
+#define SEQ192_TICKCLOCK
+
+#include <atomic>
+
+#include "globals.h"
+
+/* converts times (CLOCK_MONOTONIC microseconds) to ticks. The
+   output thread starts a segment whenever the tempo changes: a_tick
+   is the tick played at a_us, each tick lasting a_tick_us from
+   there. The previous segment is kept so that times from before the
+   last change (late or latency compensated input) are converted at
+   the tempo they were played at. One writer, any number of readers,
+   m_version is odd during a write. */
+class tickclock
+{
+
+ private:
+
+    struct segment
+    {
+        atomic < long long > m_us;
+        atomic < double > m_tick;
+        atomic < double > m_tick_us;
+    };
+
+    atomic < unsigned > m_version;
+
+    segment m_current;
+    segment m_previous;
+
+ public:
+
+    tickclock();
+
+    /* starts a new segment, the first one after reset() has no
+       previous one */
+    void set_segment( long long a_us, double a_tick, double a_tick_us );
+    void reset();
+
+    /* tick played at a_us, never below 0, -1 without a segment */
+    double get_tick_at( long long a_us );
+};
+
+#endif
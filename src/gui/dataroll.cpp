@@ -119,12 +119,9 @@ DataRoll::draw_background()
 
     SECOND_PASS_NOTE_ON: // yes this is a goto... yikes!!!!
 
-    m_sequence->reset_draw_list();
-
     for (int i = 0; i < 2; i++) {
 
         if (i == 0 && m_alt_status == 0) continue; // skip alt control view if not set
-        m_sequence->reset_draw_list(false);
         float alpha = i == 0 ? c_alpha_event_alt : 1;
         color event_color = i == 0 ? c_color_event_alt : c_color_event;
         unsigned char status;
@@ -137,6 +134,8 @@ DataRoll::draw_background()
             cc = i != 0 ? m_cc : m_alt_cc;
         }
 
+        m_sequence->reset_draw_list(status, cc);
+
         while (m_sequence->get_next_event(status, cc, &tick, &d0, &d1, &selected, selection_type) == true)
         {
             if (tick >= start_tick && tick <= end_tick)
@@ -720,7 +720,14 @@ EditWindow::menu_callback(edit_menu_action action, double data1)
 
         case EDIT_MENU_RECORD:
             // m_menu_record_state = !m_menu_record_state;
-            m_perform->get_master_midi_bus()->set_sequence_input(m_menu_record_state ? NULL : m_sequence);
+            if (m_menu_record_state) {
+                m_perform->get_master_midi_bus()->remove_sequence_input(m_sequence);
+            } else {
+                midiroute route;
+                midirouter::parse("", &route);
+                route.m_seq = m_sequence;
+                m_perform->get_master_midi_bus()->add_sequence_input(&route);
+            }
             break;
         case EDIT_MENU_RECORD_QUANTIZED:
             m_sequence->get_quantized_rec(m_menu_record_quantized.get_active());
@@ -1065,11 +1072,12 @@ EditWindow::update_event_menu()
         m_menu_items_alt_control[i+1]->set_label(ccname);
     }
 
-    unsigned char status, cc;
-    m_sequence->reset_draw_list();
-    while (m_sequence->get_next_event( &status, &cc ) == true)
+    vector<pair<unsigned char, unsigned char>> lanes;
+    m_sequence->get_used_lanes(&lanes);
+    for (auto lane : lanes)
     {
-        switch (status) {
+        unsigned char cc = lane.second;
+        switch (lane.first) {
             case EVENT_NOTE_OFF:
                 m_menu_item_noteoff.get_style_context()->add_class("checked");
                 break;
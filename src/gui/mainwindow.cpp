@@ -297,20 +297,27 @@ MainWindow::timer_callback()
 {
 
     if (!global_is_running) {
-        // SIGINT: ignore unsave modifications and quit
+        // SIGINT / SIGTERM: ignore unsave modifications and quit
         global_is_modified = false;
         close();
+        m_app->quit();
+        return false;
     }
 
+    // play state, the sequence buttons read it too
+    transport_state transport;
+    sequence_state states[c_seqs_in_set];
+    m_perform->get_play_state(&transport, m_perform->get_screenset() * c_seqs_in_set, c_seqs_in_set, states);
+
     // screenset name
-    int sset = m_perform->get_screenset();
+    int sset = transport.m_screenset;
     if (m_toolbar_sset.get_value() != sset) {
         update_sset_name(sset);
         m_toolbar_sset.set_value(sset);
     }
 
     // bpm
-    double bpm = m_perform->get_bpm();
+    double bpm = transport.m_bpm;
     if (m_toolbar_bpm.get_value() != bpm) {
         m_toolbar_bpm.set_value(bpm);
     }
@@ -331,8 +338,14 @@ MainWindow::timer_callback()
         }
     }
 
+    // background save
+    if (m_perform->get_save_failed()) {
+        MessageDialog errdialog(*this, "Error writing file.", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+        errdialog.run();
+    }
+
     // play button state
-    bool playing = m_perform->is_running();
+    bool playing = transport.m_running;
     if (playing != m_toolbar_play_state) {
         m_toolbar_play_state = playing;
         if (playing) {
@@ -360,8 +373,10 @@ MainWindow::timer_callback()
                 nsm_send_is_hidden(m_nsm);
             }
         }
-        if (m_nsm_dirty != global_is_modified) {
-            m_nsm_dirty = global_is_modified;
+        // dirty until a save is on disk
+        bool dirty = global_is_modified || m_perform->is_saving();
+        if (m_nsm_dirty != dirty) {
+            m_nsm_dirty = dirty;
             if (m_nsm_dirty) nsm_send_is_dirty(m_nsm);
             else nsm_send_is_clean(m_nsm);
         }
@@ -602,7 +617,12 @@ MainWindow::unsaved_changes()
         switch (dialog.run()) {
             case Gtk::RESPONSE_YES:
                 menu_callback(MAIN_MENU_SAVE, -1, -1);
-                if (!global_is_modified) result = true;
+                // what comes next needs the file on disk
+                if (!m_perform->wait_save()) {
+                    MessageDialog errdialog(*this, "Error writing file.", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+                    errdialog.run();
+                }
+                else if (!global_is_modified) result = true;
                 break;
             case Gtk::RESPONSE_NO:
                 result = true;
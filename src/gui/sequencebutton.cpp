@@ -93,10 +93,13 @@ SequenceButton::draw_background()
     sequence * seq = get_sequence();
     if (seq != NULL) {
 
+        sequence_state state;
+        m_perform->get_sequence_state(get_sequence_number(), &state);
+
         color color;
 
         // background
-        color = seq->get_playing() ? c_sequence_background_on : c_sequence_background;
+        color = state.m_playing ? c_sequence_background_on : c_sequence_background;
         cr->set_source_rgb(color.r, color.g, color.b);
         cr->rectangle(0, 0, width, height);
         cr->fill();
@@ -110,11 +113,11 @@ SequenceButton::draw_background()
         font.set_weight(Pango::WEIGHT_NORMAL);
 
         // queued ?
-        bool queued = get_sequence()->get_queued();
+        bool queued = state.m_queued;
         int queued_width = 0;
         if (queued)
         {
-            color = seq->get_playing() ? c_sequence_text_on : c_sequence_text;
+            color = state.m_playing ? c_sequence_text_on : c_sequence_text;
             cr->set_source_rgb(color.r, color.g, color.b);
             auto queued = create_pango_layout("⌛");
             queued->set_font_description(font);
@@ -124,8 +127,8 @@ SequenceButton::draw_background()
         }
 
         // name
-        color = seq->get_playing() ? c_sequence_text_on : c_sequence_text;
-        if (get_sequence()->get_recording()) {
+        color = state.m_playing ? c_sequence_text_on : c_sequence_text;
+        if (state.m_recording) {
             color = c_sequence_text_record;
         }
         cr->set_source_rgb(color.r, color.g, color.b);
@@ -230,8 +233,11 @@ SequenceButton::on_draw(const Cairo::RefPtr<Cairo::Context>& cr)
         cr->set_source(m_surface, 0.0, 0.0);
         cr->paint();
 
+        sequence_state state;
+        m_perform->get_sequence_state(get_sequence_number(), &state);
+
         // draw marker
-        color color = seq->get_playing() ? c_sequence_marker_on : c_sequence_marker;
+        color color = state.m_playing ? c_sequence_marker_on : c_sequence_marker;
         cr->set_source_rgb(color.r, color.g, color.b);
         cr->set_line_width(1.0);
         cr->move_to(m_next_marker_pos - 0.5, m_rect_y + 1);
@@ -250,7 +256,10 @@ SequenceButton::update()
 
     sequence * seq = get_sequence();
     if (seq != NULL) {
-        long tick = seq->get_last_tick();
+        sequence_state state;
+        m_perform->get_sequence_state(get_sequence_number(), &state);
+
+        long tick = state.m_last_tick;
         m_next_marker_pos = tick * (m_rect_w - 4) / seq->get_length() + 3;
 
         if (seq->is_dirty_main()) {
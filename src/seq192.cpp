@@ -59,8 +59,14 @@ bool global_no_gui = false;
 #endif
 
 bool global_with_jack_transport = false;
+long global_input_latency_us = 0;
+long global_thin_spacing = 0;
+bool global_thin_repeats = true;
+int global_thin_tolerance = -1;
+late_bundle_e global_late_bundles = E_LATE_BUNDLE_NOW;
 
 bool global_is_running = true;
+bool global_journal = true;
 
 char* global_oscport;
 
@@ -70,6 +76,9 @@ user_midi_bus_definition   global_user_midi_bus_definitions[c_maxBuses];
 user_instrument_definition global_user_instrument_definitions[c_max_instruments];
 user_keymap_definition     global_user_keymap_definitions[c_max_instruments];
 
+vector<user_midi_control> global_user_midi_controls;
+int global_control_feedback_bus = -1;
+
 #ifdef USE_GTK
 Glib::RefPtr<Gtk::Application> application;
 #endif
@@ -80,12 +89,43 @@ bool nsm_opional_gui_support = true;
 nsm_client_t *nsm = 0;
 bool nsm_wait = true;
 string nsm_folder = "";
+// nsm expects the session on disk when we answer: the save runs on
+// the save thread and the reply is sent by a reactor timer polling it,
+// so that neither the gui nor the reactor wait for the disk
+int nsm_save_timer = -1;
+atomic<bool> nsm_save_pending(false);
+void
+nsm_save_reply(bool a_ok)
+{
+    if (a_ok) {
+        lo_send_from(_NSM()->nsm_addr, _NSM()->_server, LO_TT_IMMEDIATE, "/reply", "ss", "/nsm/client/save", "OK");
+    } else {
+        lo_send_from(_NSM()->nsm_addr, _NSM()->_server, LO_TT_IMMEDIATE, "/error", "sis", "/nsm/client/save", ERR_GENERAL, "Error writing session file");
+    }
+}
 int
-nsm_save_cb(char **,  void *userdata)
+nsm_save_handler(const char *path, const char *types, lo_arg **argv, int argc, lo_message msg, void *user_data)
 {
-    perform *p = (perform *) userdata;
-    p->file_save();
-    return ERR_OK;
+    perform *p = (perform *) user_data;
+    if (!p->file_save()) {
+        nsm_save_reply(false);
+    } else if (nsm_save_timer < 0) {
+        // no timer to poll with
+        nsm_save_reply(p->wait_save());
+    } else {
+        nsm_save_pending = true;
+        p->get_reactor()->set_timer(nsm_save_timer, 10000);
+    }
+    return 0;
+}
+void
+nsm_save_timer_cb(int a_value, void *a_data)
+{
+    perform *p = (perform *) a_data;
+    if (!nsm_save_pending || p->is_saving()) return;
+    nsm_save_pending = false;
+    p->get_reactor()->set_timer(nsm_save_timer, 0);
+    nsm_save_reply(!p->get_save_failed());
 }
 void
 nsm_hide_cb(void *userdata)
@@ -110,15 +150,53 @@ nsm_open_cb(const char *name, const char *display_name, const char *client_id, c
     nsm_opional_gui_support = strstr(nsm_get_session_manager_features(nsm), "optional-gui");
     mkdir(nsm_folder.c_str(), 0777);
     // make sure nsm server doesn't override cached visibility state
-    nsm_send_is_shown(nsm);
+    if (!global_no_gui) nsm_send_is_shown(nsm);
     return ERR_OK;
 }
+// headless: nsm is read by the input thread instead of the gui timer
+bool nsm_dirty = false;
+void
+nsm_input_cb(int a_value, void *a_data)
+{
+    nsm_check_nowait(nsm);
+}
+void
+nsm_dirty_cb(int a_value, void *a_data)
+{
+    // dirty until a save is on disk
+    bool dirty = global_is_modified || ((perform *) a_data)->is_saving();
+    if (nsm_dirty != dirty) {
+        nsm_dirty = dirty;
+        if (nsm_dirty) nsm_send_is_dirty(nsm);
+        else nsm_send_is_clean(nsm);
+    }
+}
+
+// main thread sleeps on it in headless mode
+condition_var quit_lock;
+
+void
+signal_cb(int a_signal, void *a_data)
+{
+    quit_lock.lock();
+    global_is_running = false;
+    quit_lock.signal();
+    quit_lock.unlock();
+}
 
 
 int
 main (int argc, char *argv[])
 {
 
+    // SIGINT and SIGTERM are read by the input thread (signalfd),
+    // block them before any thread is created
+    sigset_t quit_signals;
+    sigemptyset(&quit_signals);
+    sigaddset(&quit_signals, SIGINT);
+    sigaddset(&quit_signals, SIGTERM);
+    reactor::block_signals(&quit_signals);
+
     for (int i=0; i<c_maxBuses; i++)
     {
         for (int j=0; j<16; j++) {
@@ -223,7 +301,7 @@ main (int argc, char *argv[])
         nsm = nsm_new();
         nsm_set_open_callback(nsm, nsm_open_cb, 0);
         if (nsm_init(nsm, nsm_url) == 0) {
-            nsm_send_announce(nsm, PACKAGE, ":optional-gui:dirty:", argv[0]);
+            nsm_send_announce(nsm, PACKAGE, global_no_gui ? ":dirty:" : ":optional-gui:dirty:", argv[0]);
         }
         int timeout = 0;
         while (nsm_wait) {
@@ -269,9 +347,11 @@ main (int argc, char *argv[])
     cache.parse();
 
     p->init();
+    p->get_reactor()->add_signals(&quit_signals, signal_cb, NULL);
 
     p->launch_input_thread();
     p->launch_output_thread();
+    if (global_journal) p->launch_journal_thread();
 
     #ifdef USE_JACK
     p->init_jack();
@@ -285,25 +365,29 @@ main (int argc, char *argv[])
             midifile f(global_filename);
             f.write(p, -1, -1);
         }
-        nsm_set_save_callback(nsm, nsm_save_cb, (void*) p);
+        // replaces the handler of nsm.h, which answers on return
+        nsm_save_timer = p->get_reactor()->add_timer(0, nsm_save_timer_cb, p);
+        lo_server_del_method(_NSM()->_server, "/nsm/client/save", "");
+        lo_server_add_method(_NSM()->_server, "/nsm/client/save", "", nsm_save_handler, p);
     }
 
     if (global_filename != "") {
-        midifile *f = new midifile(global_filename);
-        f->parse(p, 0);
-        delete f;
-    }
-
-    if (global_oscport != 0 && strstr(global_oscport, "/")) {
-        // liblo needs a gracefull ctrl+c handler to release unix socket
-        signal(SIGINT, [](int param){global_is_running = false;});
+        // also replays the journal left by a crash
+        if (!p->file_open(global_filename)) global_is_modified = false;
     }
 
     int status = 0;
     if (global_no_gui) {
+        if (nsm) {
+            p->get_reactor()->add(lo_server_get_socket_fd(_NSM()->_server), nsm_input_cb, NULL);
+            p->get_reactor()->add_timer(1000000, nsm_dirty_cb, p);
+        }
+        // nothing to do until SIGINT / SIGTERM
+        quit_lock.lock();
         while (global_is_running) {
-            usleep(1000);
+            quit_lock.wait();
         }
+        quit_lock.unlock();
     } else {
         #ifdef USE_GTK
         application = Gtk::Application::create();
@@ -321,19 +405,8 @@ main (int argc, char *argv[])
             }
             // enable nsm in window
             window.nsm_set_client(nsm, nsm_opional_gui_support);
-            // bind quit signal
-            signal(SIGTERM, [](int param){
-                global_is_running = false;
-                application->quit();
-            });
         }
 
-        // bind ctrl+c signal
-        signal(SIGINT, [](int param){
-            global_is_running = false;
-            application->quit();
-        });
-
 
         status = application->run(window);
         #endif
@@ -0,0 +1,86 @@
+// This file is part of seq192
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+/* stamps synthetic input events across a tempo change and checks
+   the recorded ticks, see tickclock.h */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "../src/core/tickclock.h"
+
+static int failures = 0;
+
+static void
+check( tickclock *a_clock, long long a_us, double a_expected, const char *a_what )
+{
+    double tick = a_clock->get_tick_at( a_us );
+    double error = fabs( tick - a_expected );
+
+    printf( "%-28s %12lld us  tick %10.4f  expected %10.4f  error %.6f\n",
+            a_what, a_us, tick, a_expected, error );
+
+    if ( error > 1e-6 )
+        failures++;
+}
+
+int
+main()
+{
+    /* 120 bpm then 60 bpm, at 192 ppqn */
+    const double ppqn = 192;
+    const double fast_us = 60e6 / 120 / ppqn;
+    const double slow_us = 60e6 / 60 / ppqn;
+
+    const long long start = 5000000;
+    const long long change = start + 1000000;
+
+    tickclock clock;
+
+    check( &clock, start, -1, "no segment" );
+
+    clock.set_segment( start, 0, fast_us );
+
+    check( &clock, start, 0, "start" );
+    check( &clock, start - 1000, 0, "before start" );
+    check( &clock, start + 500000, 192, "half a second in" );
+
+    /* one second at 120 bpm: 2 beats */
+    clock.set_segment( change, 384, slow_us );
+
+    check( &clock, change, 384, "tempo change" );
+    check( &clock, change - 1, 384 - 1 / fast_us, "1 us before the change" );
+    check( &clock, change - (long long) fast_us * 10, 384 - floor( fast_us ) * 10 / fast_us,
+           "10 ticks before the change" );
+    check( &clock, change + 1, 384 + 1 / slow_us, "1 us after the change" );
+    check( &clock, change + 1000000, 384 + 192, "one second after" );
+
+    /* an event played 3 ms before the change, read after it with
+       3 ms of input latency compensated */
+    check( &clock, change + 2000 - 5000, 384 - 3000 / fast_us, "latency across the change" );
+
+    /* after another change, the previous segment still applies */
+    clock.set_segment( change + 1000000, 576, fast_us );
+    check( &clock, change + 500000, 480, "within the previous segment" );
+
+    clock.reset();
+    check( &clock, change, -1, "reset" );
+
+    if ( failures )
+        printf( "%d checks failed\n", failures );
+
+    return failures ? 1 : 0;
+}